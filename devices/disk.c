@@ -7,6 +7,8 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -71,7 +73,8 @@ struct channel {
 	struct lock lock;           /* Must acquire to access the controller. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
-	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+	struct work completion;     /* Queued by interrupt handler. */
+	struct semaphore completion_wait;   /* Up'd by complete_command(). */
 
 	struct disk devices[2];     /* The devices on this channel. */
 };
@@ -95,12 +98,21 @@ static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void complete_command (struct work *);
+
+/* Runs complete_command() for every channel.  It has a single
+   worker, at high priority, so that a thread that is waiting on
+   the disk gets going again soon, and so that work on other
+   workqueues can wait for the disk without tying it up. */
+static struct workqueue disk_wq;
 
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
 	size_t chan_no;
 
+	workqueue_create (&disk_wq, "disk", 1, PRI_MAX);
+
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
 		struct channel *c = &channels[chan_no];
 		int dev_no;
@@ -121,6 +133,7 @@ disk_init (void) {
 		}
 		lock_init (&c->lock);
 		c->expecting_interrupt = false;
+		work_init (&c->completion, complete_command);
 		sema_init (&c->completion_wait, 0);
 
 		/* Initialize devices. */
@@ -520,7 +533,7 @@ interrupt_handler (struct intr_frame *f) {
 		if (f->vec_no == c->irq) {
 			if (c->expecting_interrupt) {
 				inb (reg_status (c));               /* Acknowledge interrupt. */
-				sema_up (&c->completion_wait);      /* Wake up waiter. */
+				queue_work (&disk_wq, &c->completion);
 			} else
 				printf ("%s: unexpected interrupt\n", c->name);
 			return;
@@ -529,6 +542,17 @@ interrupt_handler (struct intr_frame *f) {
 	NOT_REACHED ();
 }
 
+/* Wakes up the thread that issued the command that completed
+   with the last interrupt on channel C.  That thread reads in the
+   data itself, because BUFFER may be a user address, which is
+   mapped only in its own page table. */
+static void
+complete_command (struct work *w) {
+	struct channel *c = work_entry (w, struct channel, completion);
+
+	sema_up (&c->completion_wait);
+}
+
 static void
 inspect_read_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
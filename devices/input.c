@@ -38,6 +38,33 @@ input_getc (void) {
 	return key;
 }
 
+/* Retrieves a key from the input buffer into *KEY and returns
+   true, waiting for a key to be pressed if the buffer is empty.
+   Returns false instead if STOP returns true, either before
+   waiting or after input_wake(). */
+bool
+input_getc_unless (bool (*stop) (void), uint8_t *key) {
+	enum intr_level old_level;
+	bool success;
+
+	old_level = intr_disable ();
+	success = intq_getc_unless (&buffer, stop, key);
+	if (success)
+		serial_notify ();
+	intr_set_level (old_level);
+
+	return success;
+}
+
+/* Makes the thread waiting in input_getc_unless(), if any, call
+   its STOP function again. */
+void
+input_wake (void) {
+	enum intr_level old_level = intr_disable ();
+	intq_wake (&buffer);
+	intr_set_level (old_level);
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
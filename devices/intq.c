@@ -36,18 +36,46 @@ uint8_t
 intq_getc (struct intq *q) {
 	uint8_t byte;
 
+	intq_getc_unless (q, NULL, &byte);
+	return byte;
+}
+
+/* Removes a byte from Q, stores it in *BYTE, and returns true.
+   Like intq_getc(), sleeps first if Q is empty, but if STOP is
+   non-null, calls it before each sleep, and returns false without
+   removing anything once it returns true.  intq_wake() makes a
+   sleeper call STOP again. */
+bool
+intq_getc_unless (struct intq *q, bool (*stop) (void), uint8_t *byte) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	while (intq_empty (q)) {
+		bool stopped;
+
 		ASSERT (!intr_context ());
 		lock_acquire (&q->lock);
-		wait (q, &q->not_empty);
+		stopped = stop != NULL && stop ();
+		if (!stopped && intq_empty (q))
+			wait (q, &q->not_empty);
 		lock_release (&q->lock);
+		if (stopped)
+			return false;
 	}
 
-	byte = q->buf[q->tail];
+	*byte = q->buf[q->tail];
 	q->tail = next (q->tail);
 	signal (q, &q->not_full);
-	return byte;
+	return true;
+}
+
+/* Wakes the thread sleeping in intq_getc_unless() until Q is not
+   empty, if any, so that it checks its STOP function again. */
+void
+intq_wake (struct intq *q) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (q->not_empty != NULL) {
+		thread_unblock (q->not_empty);
+		q->not_empty = NULL;
+	}
 }
 
 /* Adds BYTE to the end of Q.
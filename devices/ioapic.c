@@ -0,0 +1,101 @@
+#include "devices/ioapic.h"
+#include <debug.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* I/O Advanced Programmable Interrupt Controller.
+
+   Delivers device interrupts to local APICs, in place of the
+   8259A PICs, so that they are acknowledged with a single write
+   to the local APIC.  Pintos does not read the ACPI tables, so it
+   looks for one I/O APIC at the conventional address and assumes
+   that ISA IRQ N is wired to its pin N, edge triggered and active
+   high, as on QEMU and most PCs.  The usual exception, the PIT on
+   pin 2, does not matter: once the I/O APIC is in use, the local
+   APIC timer ticks instead.  See [IOAPIC]. */
+
+#define IOAPIC_BASE 0xfec00000      /* Conventional physical address. */
+
+/* Memory-mapped registers. */
+#define IOREGSEL 0x00               /* Selects indirect register. */
+#define IOWIN 0x10                  /* Reads or writes it. */
+
+/* Indirect registers. */
+#define IOAPIC_VER 0x01             /* Version and # of pins. */
+#define IOAPIC_REDTBL 0x10          /* Redirection table, 2 per pin. */
+
+#define REDTBL_MASKED 0x10000       /* Pin masked. */
+
+/* Number of ISA IRQs. */
+#define ISA_IRQ_CNT 16
+
+/* -noioapic: Leave device interrupts on the 8259A PICs. */
+bool ioapic_disabled;
+
+/* Mapped registers. */
+static volatile uint32_t *ioapic;
+
+static uint32_t
+ioapic_read (int reg) {
+	ioapic[IOREGSEL / sizeof *ioapic] = reg;
+	return ioapic[IOWIN / sizeof *ioapic];
+}
+
+static void
+ioapic_write (int reg, uint32_t value) {
+	ioapic[IOREGSEL / sizeof *ioapic] = reg;
+	ioapic[IOWIN / sizeof *ioapic] = value;
+}
+
+/* Maps the I/O APIC's registers and masks all of its pins.
+   Returns true if successful, false if there is no I/O APIC or
+   it was disabled with -noioapic. */
+bool
+ioapic_init (void) {
+	uint64_t *pte;
+	uint32_t ver;
+	int pin_cnt;
+	int pin;
+
+	ASSERT (ioapic == NULL);
+
+	if (ioapic_disabled)
+		return false;
+
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (IOAPIC_BASE), 1);
+	if (pte == NULL)
+		return false;
+	*pte = IOAPIC_BASE | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) ptov (IOAPIC_BASE));
+	ioapic = ptov (IOAPIC_BASE);
+
+	/* Nothing there reads as all zeros or all ones. */
+	ver = ioapic_read (IOAPIC_VER);
+	pin_cnt = ((ver >> 16) & 0xff) + 1;
+	if ((ver & 0xff) < 0x10 || (ver & 0xff) > 0x2f || pin_cnt < ISA_IRQ_CNT) {
+		ioapic = NULL;
+		return false;
+	}
+
+	for (pin = 0; pin < pin_cnt; pin++) {
+		ioapic_write (IOAPIC_REDTBL + 2 * pin, REDTBL_MASKED);
+		ioapic_write (IOAPIC_REDTBL + 2 * pin + 1, 0);
+	}
+	return true;
+}
+
+/* Delivers ISA IRQ to the CPU whose local APIC ID is APIC_ID, on
+   vector VEC. */
+void
+ioapic_route (int irq, uint8_t vec, uint8_t apic_id) {
+	ASSERT (ioapic != NULL);
+	ASSERT (irq >= 0 && irq < ISA_IRQ_CNT);
+
+	/* Fixed delivery, physical destination, edge triggered, active
+	   high, unmasked.  Set the destination before unmasking. */
+	ioapic_write (IOAPIC_REDTBL + 2 * irq + 1, (uint32_t) apic_id << 24);
+	ioapic_write (IOAPIC_REDTBL + 2 * irq, vec);
+}
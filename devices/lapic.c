@@ -0,0 +1,282 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local Advanced Programmable Interrupt Controller.
+
+   Every CPU has its own local APIC, which it reaches through a
+   page of memory-mapped registers at the same physical address
+   on all CPUs.  Pintos uses it to send inter-processor
+   interrupts (IPIs), to start the application processors, and
+   as a one-shot timer on every CPU.  The one-shot timer gives
+   every CPU its periodic tick, except the boot CPU in tickless
+   mode, which keeps the 8254 PIT, and wakes up threads in
+   sub-tick sleeps.  See
+   [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)". */
+
+#define MSR_APIC_BASE 0x1b          /* Local APIC base address MSR. */
+#define CPUID_APIC (1 << 9)         /* CPUID.1:EDX, local APIC present. */
+
+/* Register offsets. */
+#define LAPIC_ID 0x020              /* Local APIC ID. */
+#define LAPIC_TPR 0x080             /* Task priority. */
+#define LAPIC_EOI 0x0b0             /* End of interrupt. */
+#define LAPIC_SVR 0x0f0             /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO 0x300          /* Interrupt command, low half. */
+#define LAPIC_ICR_HI 0x310          /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320       /* Timer local vector table entry. */
+#define LAPIC_TIMER_INIT 0x380      /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390       /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0       /* Timer divide configuration. */
+
+#define SVR_ENABLE 0x100            /* APIC software enable. */
+#define ICR_FIXED 0x000             /* Deliver to the given vector. */
+#define ICR_INIT 0x500              /* INIT IPI. */
+#define ICR_STARTUP 0x600           /* Start-up IPI. */
+#define ICR_ASSERT 0x4000           /* Level assert. */
+#define ICR_BUSY 0x1000             /* Delivery status: send pending. */
+#define LVT_MASKED 0x10000          /* Interrupt masked. */
+#define TIMER_DIV_16 0x3            /* Timer counts at bus clock / 16. */
+
+/* Number of PIT ticks to measure the local APIC timer over. */
+#define CALIBRATE_TICKS 10
+
+/* Longest one-shot to arm, in nanoseconds.  Longer waits take
+   more than one. */
+#define ONESHOT_MAX_NS ((int64_t) TIMER_NS_PER_TICK * TIMER_FREQ)
+
+/* Mapped local APIC registers. */
+static volatile uint32_t *lapic;
+
+/* Local APIC timer counts per timer tick. */
+static uint32_t timer_count;
+
+static intr_handler_func lapic_timer_interrupt;
+static intr_handler_func resched_interrupt;
+
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / sizeof *lapic];
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / sizeof *lapic] = value;
+	/* Reading the ID register waits for the write to finish. */
+	lapic_read (LAPIC_ID);
+}
+
+/* Returns true if this CPU has a local APIC. */
+bool
+lapic_present (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	return (edx & CPUID_APIC) != 0;
+}
+
+/* Maps the local APIC's registers, which are shared by all CPUs,
+   registers its interrupts, and enables the boot CPU's local
+   APIC.  Interrupts from the PIC keep arriving through the
+   local APIC's LINT0 pin, which firmware sets up for that. */
+void
+lapic_init (void) {
+	uint64_t pa = read_msr (MSR_APIC_BASE) & ~(uint64_t) PGMASK;
+	uint64_t *pte;
+
+	ASSERT (lapic == NULL);
+
+	/* The kernel half of every page table is shared with
+	   base_pml4, so this mapping appears everywhere. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (pa), 1);
+	if (pte == NULL)
+		PANIC ("cannot map local APIC");
+	*pte = pa | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) ptov (pa));
+	lapic = ptov (pa);
+
+	intr_register_ext (LAPIC_TIMER_VEC, lapic_timer_interrupt,
+			"Local APIC Timer");
+	intr_register_ext (LAPIC_RESCHED_VEC, resched_interrupt,
+			"Reschedule IPI");
+
+	lapic_init_ap ();
+}
+
+/* Enables the calling CPU's local APIC. */
+void
+lapic_init_ap (void) {
+	ASSERT (lapic != NULL);
+
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_TPR, 0);
+}
+
+/* Returns the calling CPU's local APIC ID. */
+uint8_t
+lapic_id (void) {
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being serviced. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends the CPU whose local APIC ID is APIC_ID an interrupt on
+   vector VEC, with command bits FLAGS. */
+static void
+send_ipi (uint8_t apic_id, uint32_t flags) {
+	lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+	lapic_write (LAPIC_ICR_LO, flags);
+	while (lapic_read (LAPIC_ICR_LO) & ICR_BUSY)
+		asm volatile ("pause");
+}
+
+/* Sends interrupt VEC to the CPU whose local APIC ID is
+   APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec) {
+	send_ipi (apic_id, ICR_FIXED | vec);
+}
+
+/* Starts the CPU whose local APIC ID is APIC_ID executing real
+   mode code at physical address ENTRY, which must be page
+   aligned and below 1 MB, with the INIT-SIPI-SIPI sequence from
+   [MP] appendix B.4.  Interrupts must be on, because this
+   sleeps. */
+void
+lapic_start_ap (uint8_t apic_id, uint64_t entry) {
+	int i;
+
+	ASSERT (entry % PGSIZE == 0 && entry < 0x100000);
+
+	send_ipi (apic_id, ICR_INIT | ICR_ASSERT);
+	timer_msleep (10);
+	for (i = 0; i < 2; i++) {
+		send_ipi (apic_id, ICR_STARTUP | (entry >> 12));
+		timer_usleep (200);
+	}
+}
+
+/* Measures how fast the local APIC timer counts against the PIT,
+   so that lapic_timer_start() can give other CPUs the same tick
+   rate as the boot CPU.  Interrupts must be on. */
+void
+lapic_timer_calibrate (void) {
+	int64_t start;
+
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+
+	/* Start counting on a tick boundary. */
+	start = timer_ticks ();
+	while (timer_ticks () == start)
+		barrier ();
+	start = timer_ticks ();
+	lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+
+	while (timer_elapsed (start) < CALIBRATE_TICKS)
+		barrier ();
+	timer_count = (UINT32_MAX - lapic_read (LAPIC_TIMER_CUR)) / CALIBRATE_TICKS;
+	lapic_write (LAPIC_TIMER_INIT, 0);
+}
+
+/* Starts the calling CPU's local APIC timer in one-shot mode.
+   If TICK, the timer also ticks the CPU TIMER_FREQ times per
+   second. */
+void
+lapic_timer_start (bool tick) {
+	struct cpu *cpu = cpu_current ();
+
+	ASSERT (timer_count > 0);
+
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_TIMER_VEC);
+	if (tick) {
+		cpu->lapic_next_tick = timer_ns () + TIMER_NS_PER_TICK;
+		lapic_write (LAPIC_TIMER_INIT, timer_count);
+	}
+}
+
+/* Returns true if local APIC timers are calibrated, so that
+   lapic_timer_arm() may be used on any CPU that is scheduling. */
+bool
+lapic_timer_ready (void) {
+	return timer_count > 0;
+}
+
+/* Arms the calling CPU's local APIC timer to go off at the CPU's
+   next tick or at the earliest deadline of timer_next_event(),
+   whichever comes first, or stops it if there is neither.
+   Interrupts must be off. */
+void
+lapic_timer_arm (void) {
+	struct cpu *cpu = cpu_current ();
+	int64_t deadline = timer_next_event ();
+	int64_t delta;
+	uint64_t count;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (cpu->lapic_next_tick != 0 && cpu->lapic_next_tick < deadline)
+		deadline = cpu->lapic_next_tick;
+	if (deadline == INT64_MAX) {
+		lapic_write (LAPIC_TIMER_INIT, 0);
+		return;
+	}
+
+	/* Round up, so as not to go off early. */
+	delta = deadline - timer_ns ();
+	if (delta > ONESHOT_MAX_NS)
+		delta = ONESHOT_MAX_NS;
+	count = 1;
+	if (delta > 0)
+		count = ((uint64_t) delta * timer_count + TIMER_NS_PER_TICK - 1)
+			/ TIMER_NS_PER_TICK;
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Local APIC timer interrupt handler.  On the boot CPU, a tick
+   advances the global clock and does the system-wide MLFQS work;
+   other CPUs only account the tick to their running thread.
+   Every CPU also wakes up its threads in sub-tick sleeps. */
+static void
+lapic_timer_interrupt (struct intr_frame *args UNUSED) {
+	struct cpu *cpu = cpu_current ();
+	int64_t now = timer_ns ();
+
+	/* Keep ticks evenly spaced, and make up for any that were
+	   late, so that the boot CPU's clock does not fall behind. */
+	while (cpu->lapic_next_tick != 0 && now >= cpu->lapic_next_tick) {
+		if (cpu->id == 0)
+			timer_tick ();
+		else {
+			thread_tick ();
+			if (thread_mlfqs)
+				increase_recent_cpu ();
+		}
+		cpu->lapic_next_tick += TIMER_NS_PER_TICK;
+	}
+
+	timer_expire_events (now);
+	lapic_timer_arm ();
+}
+
+/* Reschedule IPI handler.  Sent by thread_unblock() when it makes
+   a thread ready on this CPU that should run now. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED) {
+	intr_yield_on_return ();
+}
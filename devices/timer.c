@@ -3,10 +3,14 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/lapic.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,58 +21,128 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and the PIT count for one timer tick,
+   rounded to nearest. */
+#define PIT_FREQ 1193180
+#define TICK_COUNT ((PIT_FREQ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot the 16-bit PIT counter can hold, in ticks. */
+#define ONESHOT_MAX_TICKS (0xffff / TICK_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* -tickless: Stop the periodic tick while the CPU is idle?
+
+   In tickless mode the PIT always runs one-shot (mode 0), and
+   timer_interrupt() re-arms it for the next tick.  When only the
+   idle thread can run, timer_idle_enter() arms it for the earliest
+   sleep deadline instead, and timer_idle_exit() accounts for the
+   time that passed if some other interrupt woke the CPU first.
+   Mode 0 keeps the PIT output low while counting, so reloading it
+   early never raises a spurious IRQ 0. */
+bool timer_tickless;
+
+/* The armed one-shot covers ARMED_TICKS tick boundaries.  It was
+   programmed with ARMED_COUNT PIT counts, starting ARMED_BASE
+   counts past the previous tick boundary. */
+static unsigned armed_ticks;
+static unsigned armed_count;
+static unsigned armed_base;
+
+/* Number of PIT ticks to measure the TSC over. */
+#define CALIBRATE_TICKS 10
+
+#define CPUID_INVARIANT_TSC (1 << 8)   /* CPUID.80000007H:EDX. */
+
+/* Sub-tick sleeps shorter than this spin on the TSC, since
+   blocking costs an interrupt and two thread switches. */
+#define SPIN_NS_MAX 20000
+
+/* TSC clocksource.  timer_ns() is BASE_NS plus the TSC cycles
+   since TSC_BASE, converted to nanoseconds as
+   (cycles * tsc_mult) >> 32.  Set by timer_calibrate(); while
+   tsc_mult is 0, timer_ns() has only tick resolution. */
+static uint64_t tsc_base;
+static int64_t base_ns;
+static uint64_t tsc_mult;
+
+/* Threads sleeping in timer_usleep() or timer_nsleep() for less
+   than a tick, ordered by deadline.  A thread waits in the queue
+   of the CPU it went to sleep on, whose local APIC timer
+   interrupt wakes it; see lapic_timer_arm(). */
+static struct heap hr_queues[CPU_MAX];
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void hr_sleep (int64_t deadline);
+static heap_less_func hr_deadline_less;
+static void pit_arm (unsigned tick_cnt, unsigned carry);
+static void pit_rearm (unsigned tick_cnt);
+static uint16_t pit_read (void);
+static bool pit_irq_pending (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
-   corresponding interrupt. */
+   corresponding interrupt.  Once the local APIC timer is
+   calibrated, timer_init_lapic() usually takes over. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	int i;
+
+	for (i = 0; i < CPU_MAX; i++)
+		heap_init (&hr_queues[i], hr_deadline_less, NULL);
 
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	if (timer_tickless)
+		pit_arm (1, 0);
+	else {
+		uint16_t count = TICK_COUNT;
+
+		outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+		outb (0x40, count & 0xff);
+		outb (0x40, count >> 8);
+	}
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
-// 초당 반복 횟수
+/* Calibrates the TSC against the PIT, for timer_ns(). */
 void
 timer_calibrate (void) {
-	unsigned high_bit, test_bit;
+	uint32_t eax, ebx, ecx, edx;
+	bool invariant = false;
+	uint64_t tsc, tsc_per_tick;
+	int64_t start;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops (loops_per_tick << 1)) {
-		loops_per_tick <<= 1;
-		ASSERT (loops_per_tick != 0);
+	/* Without an invariant TSC, the TSC rate may follow the clock
+	   speed of the CPU.  It is still the best clock there is. */
+	cpuid (0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000007) {
+		cpuid (0x80000007, &eax, &ebx, &ecx, &edx);
+		invariant = (edx & CPUID_INVARIANT_TSC) != 0;
 	}
 
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops (high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	/* Start counting on a tick boundary. */
+	start = timer_ticks ();
+	while (timer_ticks () == start)
+		barrier ();
+	start = timer_ticks ();
+	tsc = rdtsc ();
+
+	while (timer_elapsed (start) < CALIBRATE_TICKS)
+		barrier ();
+	tsc_per_tick = (rdtsc () - tsc) / CALIBRATE_TICKS;
+
+	tsc_base = tsc;
+	base_ns = start * TIMER_NS_PER_TICK;
+	barrier ();
+	tsc_mult = ((uint64_t) TIMER_NS_PER_TICK << 32) / tsc_per_tick;
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+	printf ("%'"PRIu64" TSC cycles/s%s.\n", tsc_per_tick * TIMER_FREQ,
+			invariant ? "" : " (not invariant)");
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -88,6 +162,19 @@ timer_elapsed (int64_t then) {
 	return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted, as
+   measured by the TSC.  Before timer_calibrate(), only has tick
+   resolution. */
+int64_t
+timer_ns (void) {
+	uint64_t cycles;
+
+	if (tsc_mult == 0)
+		return timer_ticks () * TIMER_NS_PER_TICK;
+	cycles = rdtsc () - tsc_base;
+	return base_ns + (int64_t) (((unsigned __int128) cycles * tsc_mult) >> 32);
+}
+
 /* Suspends execution for approximately TICKS timer ticks. */
 void
 timer_sleep (int64_t ticks) {
@@ -116,21 +203,72 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
-/* Prints timer statistics. */
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, arms the timer to fire at the earliest
+   sleep deadline or delayed work rather than at the next tick. */
 void
-timer_print_stats (void) {
-	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+timer_idle_enter (void) {
+	int64_t next;
+	int64_t tick_cnt;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	/* Only the boot CPU sees the PIT, and with other CPUs online
+	   it cannot stop: they read `ticks' and put threads to sleep
+	   without its knowledge. */
+	if (!timer_tickless || cpu_cnt > 1)
+		return;
+
+	next = thread_next_awake_tick ();
+	if (workqueue_next_tick () < next)
+		next = workqueue_next_tick ();
+	tick_cnt = next == INT64_MAX ? ONESHOT_MAX_TICKS : next - ticks;
+	if (tick_cnt > ONESHOT_MAX_TICKS)
+		tick_cnt = ONESHOT_MAX_TICKS;
+
+	/* The MLFQS samples load_avg once a second, so do not sleep
+	   past a second boundary. */
+	if (thread_mlfqs && tick_cnt > TIMER_FREQ - ticks % TIMER_FREQ)
+		tick_cnt = TIMER_FREQ - ticks % TIMER_FREQ;
+
+	if (tick_cnt > 1)
+		pit_rearm (tick_cnt);
+}
+
+/* Called by the idle thread, with interrupts off, after it wakes
+   up.  In tickless mode, if an interrupt other than the timer woke
+   the CPU before the one-shot expired, accounts for the elapsed
+   time and goes back to a tick at a time. */
+void
+timer_idle_exit (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (timer_tickless && armed_ticks > 1)
+		pit_rearm (1);
+}
+
+/* Moves the boot CPU's tick from the PIT to its local APIC timer,
+   which is cheaper to acknowledge and does not tie device
+   interrupts to the PICs.  In tickless mode, the PIT keeps the
+   tick, since timer_idle_enter() reprograms it.  The local APIC
+   timer must be calibrated. */
+void
+timer_init_lapic (void) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!timer_tickless) {
+		intr_pic_mask (0);
+		lapic_timer_start (true);
+	} else
+		lapic_timer_start (false);
+	intr_set_level (old_level);
 }
-
-/* Timer interrupt handler. */
-//
-static void
-timer_interrupt (struct intr_frame *args UNUSED) {
-	struct thread	*cur_thread = thread_current();
 
+/* Advances the clock by one tick on the boot CPU.  Called by the
+   interrupt handler of whichever timer ticks the boot CPU. */
+void
+timer_tick (void) {
 	ticks++;
 	thread_tick ();
-	thread_awake(ticks);
 
 	// increase recent_cpu value of current thread
 	if(thread_mlfqs)
@@ -151,38 +289,119 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 			recalculate_priority();
 		}
 	}
+
+	thread_awake(ticks);
+	workqueue_tick (ticks);
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-// 반복 횟수를 통한 시스템 성능 측정
-static bool
-too_many_loops (unsigned loops) {
-	/* Wait for a timer tick. */
-	int64_t start = ticks;
-	while (ticks == start)
-		barrier ();
+/* Returns the earliest deadline of the threads sleeping for less
+   than a tick on the running CPU, in timer_ns() time, or
+   INT64_MAX if there are none.  Interrupts must be off. */
+int64_t
+timer_next_event (void) {
+	struct heap *q = &hr_queues[cpu_current ()->id];
 
-	/* Run LOOPS loops. */
-	start = ticks;
-	busy_wait (loops);
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (heap_empty (q))
+		return INT64_MAX;
+	return heap_entry (heap_min (q), struct thread, hr_elem)->hr_deadline;
+}
 
-	/* If the tick count changed, we iterated too long. */
-	barrier ();
-	return start != ticks;
+/* Wakes the threads sleeping for less than a tick on the running
+   CPU whose deadlines are at or before NOW.  Called by the local
+   APIC timer interrupt handler. */
+void
+timer_expire_events (int64_t now) {
+	struct heap *q = &hr_queues[cpu_current ()->id];
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	while (!heap_empty (q)) {
+		struct thread *t = heap_entry (heap_min (q), struct thread, hr_elem);
+
+		if (t->hr_deadline > now)
+			break;
+		heap_pop_min (q);
+		thread_unblock (t);
+	}
+}
+
+/* Prints timer statistics. */
+void
+timer_print_stats (void) {
+	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
+
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED) {
+	unsigned tick_cnt = 1;
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+	if (timer_tickless) {
+		/* Mode 0 keeps counting down past zero, so the negated
+		   count is how late this interrupt is.  Carry it into the
+		   next one-shot so that ticks stay evenly spaced. */
+		uint16_t late = -pit_read ();
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) {
-	while (loops-- > 0)
-		barrier ();
+		tick_cnt = armed_ticks;
+		pit_arm (1, late < TICK_COUNT ? late : 0);
+	}
+
+	while (tick_cnt-- > 0)
+		timer_tick ();
+}
+
+/* Programs the PIT as a one-shot that ends TICK_CNT tick
+   boundaries later, given that CARRY counts have already passed
+   since the last boundary. */
+static void
+pit_arm (unsigned tick_cnt, unsigned carry) {
+	ASSERT (tick_cnt >= 1 && tick_cnt <= ONESHOT_MAX_TICKS);
+	ASSERT (carry < TICK_COUNT);
+
+	armed_ticks = tick_cnt;
+	armed_base = carry;
+	armed_count = tick_cnt * TICK_COUNT - carry;
+
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, armed_count & 0xff);
+	outb (0x40, armed_count >> 8);
+}
+
+/* Cuts the armed one-shot short, adds the whole ticks that have
+   passed to the tick count, and re-arms for TICK_CNT ticks.  If
+   the one-shot has already expired, does nothing and leaves it to
+   timer_interrupt(). */
+static void
+pit_rearm (unsigned tick_cnt) {
+	uint16_t remaining = pit_read ();
+	unsigned elapsed;
+
+	/* Check for a pending IRQ after latching the count, so that a
+	   count that wrapped past zero is never trusted. */
+	if (pit_irq_pending ())
+		return;
+
+	elapsed = armed_base + (armed_count - remaining);
+	ticks += elapsed / TICK_COUNT;
+	pit_arm (tick_cnt, elapsed % TICK_COUNT);
+}
+
+/* Latches and returns the current count of PIT counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: latch counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return (hi << 8) | lo;
+}
+
+/* Returns true if IRQ 0 is raised but not yet serviced. */
+static bool
+pit_irq_pending (void) {
+	outb (0x20, 0x0a);    /* OCW3: read interrupt request register. */
+	return (inb (0x20) & 0x01) != 0;
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -203,10 +422,40 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   processes. */
 		timer_sleep (ticks);
 	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+		/* Otherwise, wait for a deadline on the TSC.  DENOM is a
+		   power of 1000 no greater than 1e9, and NUM is less than a
+		   tick's worth, so this does not overflow. */
+		ASSERT (1000000000 % denom == 0);
+		hr_sleep (timer_ns () + num * (1000000000 / denom));
+	}
+}
+
+/* Waits until timer_ns() reaches DEADLINE, which is less than a
+   tick away.  Blocks until the local APIC timer interrupt at
+   DEADLINE if it is far enough away and the CPU has a local APIC
+   timer, and otherwise spins. */
+static void
+hr_sleep (int64_t deadline) {
+	if (deadline - timer_ns () > SPIN_NS_MAX && lapic_timer_ready ()) {
+		enum intr_level old_level = intr_disable ();
+		struct thread *t = thread_current ();
+
+		t->hr_deadline = deadline;
+		heap_push (&hr_queues[t->cpu->id], &t->hr_elem);
+		lapic_timer_arm ();
+		thread_block ();
+		intr_set_level (old_level);
+		return;
 	}
+
+	while (timer_ns () < deadline)
+		asm volatile ("pause");
+}
+
+/* Orders sleeping threads by hr_deadline. */
+static bool
+hr_deadline_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, hr_elem)->hr_deadline
+		< heap_entry (b, struct thread, hr_elem)->hr_deadline;
 }
@@ -2,14 +2,19 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/rcu.h"
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	int ref_cnt;                /* Number of references. */
+	struct rcu_head rcu;        /* Frees the file after a grace period. */
 };
 
+static void file_free (struct rcu_head *);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -20,6 +25,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
 		return file;
 	} else {
 		inode_close (inode);
@@ -48,16 +54,40 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Takes another reference to FILE, which the caller found under
+ * rcu_read_lock(), and returns FILE, unless its last reference
+ * has already been dropped, in which case returns a null pointer.
+ * The caller drops the reference with file_close(). */
+struct file *
+file_get (struct file *file) {
+	int ref_cnt = file->ref_cnt;
+
+	while (ref_cnt > 0)
+		if (__atomic_compare_exchange_n (&file->ref_cnt, &ref_cnt,
+					ref_cnt + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return file;
+	return NULL;
+}
+
+/* Drops a reference to FILE, and closes FILE if it was the last
+ * one.  The memory is freed only after an RCU grace period, since
+ * file_get() may still be looking at it. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	if (file != NULL
+			&& __atomic_sub_fetch (&file->ref_cnt, 1, __ATOMIC_ACQ_REL) == 0) {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		call_rcu (&file->rcu, file_free);
 	}
 }
 
+/* Frees the file that contains HEAD. */
+static void
+file_free (struct rcu_head *head) {
+	free (rcu_entry (head, struct file, rcu));
+}
+
 /* Returns the inode encapsulated by FILE. */
 struct inode *
 file_get_inode (struct file *file) {
@@ -1,19 +1,38 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/workqueue.h"
+
+/* Ticks between a change to the free map and its writeback. */
+#define WRITEBACK_DELAY TIMER_FREQ
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* The free map is written back to its file by writeback_work,
+ * at most WRITEBACK_DELAY ticks after it changes, instead of on
+ * every change.  free_map_close() writes it back at once. */
+static struct lock free_map_lock;    /* Protects the members above. */
+static bool free_map_dirty;          /* Changed since written back? */
+static struct delayed_work writeback_work;
+
+static void free_map_writeback (void);
+static void writeback (struct work *);
+
 /* Initializes the free map. */
 void
 free_map_init (void) {
 	free_map = bitmap_create (disk_size (filesys_disk));
 	if (free_map == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
+	lock_init (&free_map_lock);
+	delayed_work_init (&writeback_work, writeback);
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
 }
@@ -24,13 +43,16 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+	disk_sector_t sector;
+
+	lock_acquire (&free_map_lock);
+	sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	if (sector != BITMAP_ERROR) {
+		free_map_dirty = true;
+		queue_delayed_work (&system_wq, &writeback_work, WRITEBACK_DELAY);
 	}
+	lock_release (&free_map_lock);
+
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
@@ -39,9 +61,12 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	free_map_dirty = true;
+	queue_delayed_work (&system_wq, &writeback_work, WRITEBACK_DELAY);
+	lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,7 +82,11 @@ free_map_open (void) {
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	lock_acquire (&free_map_lock);
+	free_map_writeback ();
 	file_close (free_map_file);
+	free_map_file = NULL;
+	lock_release (&free_map_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -74,4 +103,27 @@ free_map_create (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	free_map_dirty = false;
+}
+
+/* Writes the free map to its file, if it has changed and the
+ * file is open.  The caller must hold free_map_lock. */
+static void
+free_map_writeback (void) {
+	ASSERT (lock_held_by_current_thread (&free_map_lock));
+
+	if (free_map_dirty && free_map_file != NULL) {
+		if (bitmap_write (free_map, free_map_file))
+			free_map_dirty = false;
+		else
+			printf ("free map: writeback failed\n");
+	}
+}
+
+/* Delayed work that writes back the free map. */
+static void
+writeback (struct work *w UNUSED) {
+	lock_acquire (&free_map_lock);
+	free_map_writeback ();
+	lock_release (&free_map_lock);
 }
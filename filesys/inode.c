@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -34,6 +36,7 @@ struct inode {
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
+	struct rcu_head rcu;                /* Frees inode when closed. */
 };
 
 /* Returns the disk sector that contains byte offset POS within
@@ -53,10 +56,21 @@ byte_to_sector (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Serializes changes to open_inodes.  Opening an inode that is
+ * already open only reads the list, which it does under RCU
+ * without taking this lock, so open_cnt is updated atomically and
+ * closed inodes are freed only after an RCU grace period. */
+static struct lock open_inodes_lock;
+
+static struct inode *find_open_inode (disk_sector_t sector);
+static bool inode_reopen_unless_closed (struct inode *);
+static void inode_free (struct rcu_head *);
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,39 +115,76 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	rcu_read_lock ();
+	inode = find_open_inode (sector);
+	rcu_read_unlock ();
+	if (inode != NULL)
+		return inode;
+
+	/* Check again, since another thread may have opened it in
+	 * the meantime. */
+	lock_acquire (&open_inodes_lock);
+	inode = find_open_inode (sector);
+	if (inode != NULL) {
+		lock_release (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize, then publish. */
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
+	rcu_list_push_front (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+ * if SECTOR is not open.  The caller must be in an RCU read-side
+ * critical section or hold open_inodes_lock. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = rcu_dereference (open_inodes.head.next);
+			e != list_end (&open_inodes); e = rcu_dereference (e->next)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector && inode_reopen_unless_closed (inode))
+			return inode;
+	}
+	return NULL;
+}
+
+/* Reopens INODE and returns true, unless its last opener has
+ * already closed it, in which case returns false. */
+static bool
+inode_reopen_unless_closed (struct inode *inode) {
+	int open_cnt = inode->open_cnt;
+
+	while (open_cnt > 0)
+		if (__atomic_compare_exchange_n (&inode->open_cnt, &open_cnt,
+					open_cnt + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
+	return false;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -148,14 +199,28 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	int open_cnt;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
+	/* If this is not the last opener, just drop the count. */
+	open_cnt = inode->open_cnt;
+	while (open_cnt > 1)
+		if (__atomic_compare_exchange_n (&inode->open_cnt, &open_cnt,
+					open_cnt - 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+
+	/* Release resources if this was the last opener.  Once
+	 * open_cnt is 0, inode_open() will not reopen INODE, but
+	 * readers may still be looking at it, so it is freed only after
+	 * an RCU grace period. */
+	lock_acquire (&open_inodes_lock);
+	if (__atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED) == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		lock_release (&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,8 +229,15 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
-	}
+		call_rcu (&inode->rcu, inode_free);
+	} else
+		lock_release (&open_inodes_lock);
+}
+
+/* Frees the inode that contains HEAD. */
+static void
+inode_free (struct rcu_head *head) {
+	free (rcu_entry (head, struct inode, rcu));
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
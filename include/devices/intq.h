@@ -37,6 +37,8 @@ void intq_init (struct intq *);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
+bool intq_getc_unless (struct intq *, bool (*stop) (void), uint8_t *);
+void intq_wake (struct intq *);
 void intq_putc (struct intq *, uint8_t);
 
 #endif /* devices/intq.h */
@@ -0,0 +1,13 @@
+#ifndef DEVICES_IOAPIC_H
+#define DEVICES_IOAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* -noioapic: Leave device interrupts on the 8259A PICs. */
+extern bool ioapic_disabled;
+
+bool ioapic_init (void);
+void ioapic_route (int irq, uint8_t vec, uint8_t apic_id);
+
+#endif /* devices/ioapic.h */
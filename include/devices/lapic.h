@@ -0,0 +1,25 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors raised by the local APIC.  They sit above the
+   PIC's 0x20...0x2f and are treated as external interrupts. */
+#define LAPIC_TIMER_VEC 0xf0        /* Local APIC timer. */
+#define LAPIC_RESCHED_VEC 0xf1      /* Reschedule IPI. */
+#define LAPIC_SPURIOUS_VEC 0xff     /* Spurious interrupt. */
+
+bool lapic_present (void);
+void lapic_init (void);
+void lapic_init_ap (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_start_ap (uint8_t apic_id, uint64_t entry);
+void lapic_timer_calibrate (void);
+void lapic_timer_start (bool tick);
+bool lapic_timer_ready (void);
+void lapic_timer_arm (void);
+
+#endif /* devices/lapic.h */
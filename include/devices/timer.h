@@ -2,22 +2,38 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Nanoseconds per timer tick. */
+#define TIMER_NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* -tickless: Stop the periodic tick while the CPU is idle. */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
+void timer_init_lapic (void);
+void timer_tick (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+int64_t timer_next_event (void);
+void timer_expire_events (int64_t now);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -36,6 +36,16 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra. */
+	SYS_FUTEX,                  /* Wait on or wake a futex. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* Terminate the calling thread. */
 };
 
+/* Operations for SYS_FUTEX. */
+#define FUTEX_WAIT 0            /* Sleep if the futex has a value. */
+#define FUTEX_WAKE 1            /* Wake up to N waiters. */
+
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+/* Mutex built on the futex() system call.  Locking and unlocking
+   an uncontended mutex are single atomic instructions; only a
+   thread that has to wait, or that releases a mutex someone is
+   waiting on, enters the kernel. */
+struct mutex {
+	int state;          /* 0: unlocked, 1: locked, 2: locked, maybe waiters. */
+};
+
+/* Initializer for a statically allocated mutex. */
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
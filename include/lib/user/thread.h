@@ -0,0 +1,20 @@
+#ifndef __LIB_USER_THREAD_H
+#define __LIB_USER_THREAD_H
+
+#include <debug.h>
+
+/* Threads of a user process.  All of a process's threads share
+   its address space and file descriptors; each has a user stack
+   of its own.  exit() in any thread ends the whole process. */
+
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+typedef void thread_func (void *aux);
+
+tid_t thread_create (thread_func *, void *aux);
+int thread_join (tid_t);
+void thread_exit (void) NO_RETURN;
+
+#endif /* lib/user/thread.h */
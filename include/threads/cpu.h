@@ -0,0 +1,71 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+/* Maximum number of CPUs that Pintos will bring up. */
+#define CPU_MAX 8
+
+/* Physical address that the AP start-up code in ap-start.S is
+   copied to.  Must be page aligned and below 1 MB, because APs
+   begin executing in real mode at this address. */
+#define AP_TRAMPOLINE 0x8000
+
+/* Offsets of the struct cpu members that syscall_entry reads
+   through %gs.  Checked against the structure in cpu.c. */
+#define CPU_TSS 0
+#define CPU_SYSCALL_RBX 8
+#define CPU_SYSCALL_R12 16
+
+#ifndef __ASSEMBLER__
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+struct task_state;
+
+/* A processor.
+
+   Every CPU runs its own scheduler on its own ready queue, with
+   its own idle thread.  The running thread's `cpu' member points
+   to the struct cpu of the processor it is running on, so
+   cpu_current() is as cheap as thread_current(). */
+struct cpu {
+	/* Used by syscall_entry, which finds this structure through
+	   %gs.  Keep these first; see CPU_* above. */
+	struct task_state *tss;         /* This CPU's TSS. */
+	uint64_t syscall_rbx;           /* Scratch for syscall_entry. */
+	uint64_t syscall_r12;           /* Scratch for syscall_entry. */
+
+	int id;                         /* Index into cpus[]. */
+	uint8_t lapic_id;               /* Local APIC ID. */
+	volatile bool started;          /* Set once the CPU is scheduling. */
+	struct thread *idle_thread;     /* This CPU's idle thread. */
+	struct thread *curr;            /* Thread running on this CPU. */
+	unsigned thread_ticks;          /* # of timer ticks since last yield. */
+	unsigned balance_ticks;         /* # of timer ticks since last rebalance. */
+	uint64_t rcu_qs_cnt;            /* # of RCU quiescent states. */
+	uint64_t switch_tsc;            /* TSC when `curr' was charged last. */
+	struct thread *fpu_owner;       /* Thread whose FPU state is loaded. */
+
+	/* Owned by interrupt.c. */
+	bool in_external_intr;          /* Processing an external interrupt? */
+	bool yield_on_return;           /* Yield on interrupt return? */
+
+	/* Owned by devices/lapic.c. */
+	int64_t lapic_next_tick;        /* timer_ns() of next local APIC
+	                                   timer tick, or 0 if none. */
+};
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* -smp=N: bring up at most N CPUs. */
+extern int cpu_limit;
+
+struct cpu *cpu_current (void);
+void smp_init (void);
+void ap_main (struct cpu *) NO_RETURN;
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* threads/cpu.h */
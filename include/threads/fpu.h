@@ -0,0 +1,23 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* Size and required alignment of a thread's saved FPU state, in
+   the format of the FXSAVE instruction. */
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_ALIGN 16
+
+void fpu_init (void);
+void fpu_init_ap (void);
+
+bool fpu_trap (void);
+void fpu_switch (struct thread *prev);
+void fpu_exit (void);
+
+void kernel_fpu_begin (void);
+void kernel_fpu_end (void);
+
+#endif /* threads/fpu.h */
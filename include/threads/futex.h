@@ -0,0 +1,12 @@
+#ifndef THREADS_FUTEX_H
+#define THREADS_FUTEX_H
+
+#include <stdbool.h>
+
+void futex_init (void);
+bool futex_wait (int *addr, int val, const void *owner,
+		bool (*stop) (void));
+int futex_wake (int *addr, int cnt);
+void futex_cancel (const void *owner);
+
+#endif /* threads/futex.h */
@@ -0,0 +1,54 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+
+/* Read-copy update.
+
+   Lets readers walk a shared data structure without taking any
+   lock, while writers, which still exclude each other with an
+   ordinary lock, change it by publishing new versions of the
+   parts they change.  What a writer unlinks may still be in use
+   by readers that found it earlier, so it is freed only after a
+   "grace period" in which every CPU has passed through a
+   quiescent state, where it cannot be reading.
+
+   A reader brackets its accesses with rcu_read_lock() and
+   rcu_read_unlock(), which only keep the running thread from
+   being preempted, and loads shared pointers with
+   rcu_dereference().  It must not sleep until rcu_read_unlock().
+   A writer stores pointers with rcu_assign_pointer() and frees
+   what it unlinked with call_rcu() or after synchronize_rcu(). */
+
+/* Deferred callback, embedded in the structure to be freed. */
+struct rcu_head {
+	struct list_elem elem;      /* Element in list of pending callbacks. */
+	void (*func) (struct rcu_head *);   /* Callback. */
+};
+
+/* Converts pointer to rcu_head RCU_HEAD into a pointer to the
+   structure that RCU_HEAD is embedded inside.  Like
+   list_entry(). */
+#define rcu_entry(RCU_HEAD, STRUCT, MEMBER)             \
+	((STRUCT *) ((uint8_t *) &(RCU_HEAD)->elem      \
+		- offsetof (STRUCT, MEMBER.elem)))
+
+/* Loads the RCU-protected pointer P. */
+#define rcu_dereference(P) __atomic_load_n (&(P), __ATOMIC_CONSUME)
+
+/* Stores V into the RCU-protected pointer P, after everything
+   the caller wrote before, so that readers that see V also see
+   what it points to fully initialized. */
+#define rcu_assign_pointer(P, V) __atomic_store_n (&(P), (V), __ATOMIC_RELEASE)
+
+void rcu_init (void);
+
+void rcu_read_lock (void);
+void rcu_read_unlock (void);
+
+void call_rcu (struct rcu_head *, void (*func) (struct rcu_head *));
+void synchronize_rcu (void);
+
+void rcu_list_push_front (struct list *, struct list_elem *);
+
+#endif /* threads/rcu.h */
@@ -0,0 +1,22 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+
+/* switch_context()'s frame on the stack of a thread that is
+   switched out: the callee-saved registers, lowest address
+   first, then the address to return to. */
+struct switch_frame {
+	uint64_t r15;
+	uint64_t r14;
+	uint64_t r13;
+	uint64_t r12;
+	uint64_t rbx;
+	uint64_t rbp;
+	void (*rip) (void);
+};
+
+void switch_context (uint64_t *save_rsp, uint64_t rsp);
+void switch_entry (void);
+
+#endif /* threads/switch.h */
@@ -1,13 +1,15 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, by priority. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -15,15 +17,24 @@ void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
-bool compare_sema_priority(struct list_elem *, struct list_elem *, void *aux);
 
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+
+	/* Adaptive locks only; see lock_init_adaptive(). */
+	const char *name;           /* Name, or NULL if not adaptive. */
+	struct list_elem elem;      /* Element in list of adaptive locks. */
+
+	/* Statistics, updated by the holder. */
+	uint64_t acquire_cnt;       /* # of times acquired. */
+	uint64_t contend_cnt;       /* # of times found held. */
+	uint64_t wait_cycles;       /* TSC cycles spent waiting. */
 };
 
 void lock_init (struct lock *);
+void lock_init_adaptive (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -33,10 +44,12 @@ void set_donation_priority(struct lock *, int, int);
 void remove_donation_list(struct lock *);
 void change_donation_priority(void);
 bool cmp_lock_priority(struct list_elem *, struct list_elem *, void *);
+void donate_priority (void);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, by priority. */
 };
 
 void cond_init (struct condition *);
@@ -44,6 +57,57 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.
+
+   Any number of threads may hold an RW lock for reading at once,
+   or a single thread may hold it for writing.  Writers are
+   preferred: once a writer is waiting, new readers wait behind
+   it.  A thread waiting for an RW lock donates its priority to
+   every thread that holds it.  RW locks are not recursive. */
+struct rwlock {
+	int readers;                /* # of threads holding for reading. */
+	struct thread *writer;      /* Thread holding for writing, or NULL. */
+	struct list holders;        /* rwlock_hold of each holder. */
+	struct heap read_waiters;   /* Threads waiting to read, by priority. */
+	struct heap write_waiters;  /* Threads waiting to write, by priority. */
+};
+
+/* A thread's hold on an RW lock, from the time it starts to
+   acquire the lock until it releases it.  Supplied by the caller,
+   usually as a local variable, and passed to both the acquire
+   and the matching release, so that a thread may hold any number
+   of RW locks at once. */
+struct rwlock_hold {
+	struct list_elem elem;      /* Element in the RW lock's holders. */
+	struct list_elem thread_elem; /* Element in thread's rw_holds. */
+	struct rwlock *rwlock;      /* RW lock held or waited for. */
+	struct thread *thread;      /* Holding thread. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *, struct rwlock_hold *);
+void rwlock_release_read (struct rwlock *, struct rwlock_hold *);
+void rwlock_acquire_write (struct rwlock *, struct rwlock_hold *);
+void rwlock_release_write (struct rwlock *, struct rwlock_hold *);
+
+void synch_update_priority (struct thread *, int priority);
+
+/* Spinlock.
+
+   Busy-waits instead of sleeping, so it can be used where a lock
+   cannot, such as in interrupt handlers and in the scheduler.  It
+   is held by a CPU rather than by a thread, and must be acquired
+   and released with interrupts off. */
+struct spinlock {
+	volatile int locked;        /* 1 if held, 0 if free. */
+	struct cpu *cpu;            /* CPU holding the lock. */
+};
+
+void spin_init (struct spinlock *);
+void spin_lock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+bool spin_held (const struct spinlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
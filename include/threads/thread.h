@@ -2,10 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -29,18 +32,30 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-#define ALIVE_CHILD -2
-#define ALREADY_WAIT -3
+/* Thread nice values. */
+#define NICE_MIN -20                    /* Greediest. */
+#define NICE_DEFAULT 0                  /* Default nice value. */
+#define NICE_MAX 20                     /* Most willing to yield. */
+
+/* Pages in each thread's block, which holds its struct thread
+ * and its kernel stack.  Must be a power of two. */
+#ifndef THREAD_STACK_PAGES
+#define THREAD_STACK_PAGES 2
+#endif
+#define THREAD_STACK_SIZE (THREAD_STACK_PAGES * PGSIZE)
 
 /* A kernel thread or user process.
  *
- * Each thread structure is stored in its own 4 kB page.  The
- * thread structure itself sits at the very bottom of the page
- * (at offset 0).  The rest of the page is reserved for the
- * thread's kernel stack, which grows downward from the top of
- * the page (at offset 4 kB).  Here's an illustration:
+ * Each thread structure is stored in its own block of
+ * THREAD_STACK_SIZE bytes, aligned to its size.  The thread
+ * structure itself sits at the very bottom of the block (at
+ * offset 0).  The rest of the block is reserved for the thread's
+ * kernel stack, which grows downward from the top of the block
+ * (at offset THREAD_STACK_SIZE, 8 kB by default).  The page just
+ * below the block is left unmapped, as a guard page.  Here's an
+ * illustration:
  *
- *      4 kB +---------------------------------+
+ *      8 kB +---------------------------------+
  *           |          kernel stack           |
  *           |                |                |
  *           |                |                |
@@ -62,6 +77,8 @@ typedef int tid_t;
  *           |               name              |
  *           |              status             |
  *      0 kB +---------------------------------+
+ *           |     guard page (not mapped)     |
+ *     -4 kB +---------------------------------+
  *
  * The upshot of this is twofold:
  *
@@ -73,22 +90,20 @@ typedef int tid_t;
  *
  *    2. Second, kernel stacks must not be allowed to grow too
  *       large.  If a stack overflows, it will corrupt the thread
- *       state.  Thus, kernel functions should not allocate large
- *       structures or arrays as non-static local variables.  Use
- *       dynamic allocation with malloc() or palloc_get_page()
- *       instead.
+ *       state, and past that, fault on the guard page.  Thus,
+ *       kernel functions should not allocate large structures or
+ *       arrays as non-static local variables.  Use dynamic
+ *       allocation with malloc() or palloc_get_page() instead.
  *
  * The first symptom of either of these problems will probably be
  * an assertion failure in thread_current(), which checks that
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+ * A thread blocked on a semaphore or RW lock is instead in one of
+ * its waiters heaps through `wait_elem' (synch.c), so that it can
+ * be moved within the heap when its priority changes. */
 struct thread {
 	/* Owned by thread.c. */
 	tid_t tid;                          /* Thread identifier. */
@@ -96,40 +111,66 @@ struct thread {
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
 	int64_t awake_tick;
+	struct heap_elem sleep_elem;        /* Element in the sleep queue. */
+	struct cpu *cpu;                    /* CPU running or last to run. */
+	int preempt_cnt;                    /* Preemption disabled if nonzero. */
+	bool preempt_pending;               /* Yield once preemptible? */
 	struct list donation_list;
 	struct lock *wait_on_lock;
+	struct rwlock_hold *wait_on_rwlock; /* Hold waiting for, or NULL. */
+	struct list rw_holds;               /* rwlock_hold of each RW lock held. */
 	struct list_elem donation_elem;
 	int origin_priority;
 	int recent_cpu;
+	int64_t recent_cpu_epoch;           /* Decays applied to recent_cpu. */
+	bool recent_cpu_changed;            /* In recent_cpu_changed list? */
+	struct list_elem recent_cpu_elem;   /* recent_cpu_changed list element. */
 	int nice;
-	int exit_status;
-	struct file *file_table[64];
-	int fd;
+
+	/* Deadline class; see thread_set_deadline(). */
+	bool dl;                            /* In the deadline class? */
+	int64_t dl_runtime;                 /* Budget per period, in ns. */
+	int64_t dl_deadline;                /* Relative deadline, in ns. */
+	int64_t dl_period;                  /* Period, in ns. */
+	uint64_t dl_density;                /* RUNTIME / DEADLINE, fixed point. */
+	struct cpu *dl_cpu;                 /* CPU admitted on. */
+	int64_t dl_abs_deadline;            /* Current deadline, in timer_ns(). */
+	int64_t dl_budget;                  /* Budget left, in ns. */
+	struct heap_elem dl_elem;           /* Element in EDF ready queue. */
+
+	/* Fair scheduler; see thread_cfs. */
+	int64_t vruntime;                   /* Run time weighted by nice, in ns. */
+	struct heap_elem fair_elem;         /* Element in fair ready queue. */
+
+	int64_t exec_start;                 /* timer_ns() when last charged. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct heap_elem wait_elem;         /* Element in semaphore waiters. */
+	struct heap *blocked_heap;          /* Heap WAIT_ELEM is in, or NULL. */
+	struct condition *blocked_cond;     /* Condition waiting on, or NULL. */
+	struct heap_elem *cond_elem;        /* Element in BLOCKED_COND waiters. */
 	struct list_elem all_elem;
 
-	struct list child_list;
-	struct list_elem child_elem;
-	struct thread *parent;
 	struct intr_frame parent_if;
-	bool is_wait;
-	struct semaphore wait_sema;
-	struct semaphore exit_sema;
-	struct semaphore fork_sema;
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
-	uint64_t *pml4;                     /* Page map level 4 */
-#endif
-#ifdef VM
-	/* Table for whole virtual memory owned by thread. */
-	struct supplemental_page_table spt;
+	struct process *process;            /* Process, or null if kernel thread. */
+	int stack_slot;                     /* Slot in process's threads[]. */
 #endif
 
+	/* Owned by devices/timer.c. */
+	int64_t hr_deadline;                /* End of sub-tick sleep, in ns. */
+	struct heap_elem hr_elem;           /* Element in sub-tick sleep queue. */
+
+	/* Owned by threads/fpu.c. */
+	void *fpu_mem;                      /* Saved FPU state, or null. */
+	struct cpu *fpu_cpu;                /* CPU that last loaded FPU state. */
+
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	struct intr_frame tf;               /* Context for first entry. */
+	uint64_t switch_rsp;                /* Stack pointer when switched out. */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -138,11 +179,20 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, schedule threads outside the deadline class by their
+   share of the CPU, weighted by nice, instead of by priority.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
 void thread_sleep(int64_t sleep_tick);
 void thread_awake(int64_t cur_tick);
+int64_t thread_next_awake_tick (void);
 
 void thread_init (void);
 void thread_start (void);
+struct thread *thread_prepare_ap (struct cpu *);
+void thread_init_ap (void);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
@@ -153,6 +203,10 @@ tid_t thread_create (const char *name, int priority, thread_func *, void *);
 void thread_block (void);
 void thread_unblock (struct thread *);
 
+void thread_preempt_disable (void);
+void thread_preempt_enable (void);
+void thread_preempt (void);
+
 struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
@@ -162,6 +216,12 @@ void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *, int);
+bool thread_runs_before (const struct thread *, const struct thread *);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+void thread_clear_deadline (void);
+void thread_deadline_yield (void);
 
 bool compare_thread_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED);
 bool compare_thread_origin_priority(struct list_elem *, struct list_elem *, void *aux UNUSED);
@@ -192,4 +252,9 @@ int div_mixed(int, int);
 
 void do_iret (struct intr_frame *tf);
 
+/* Returns the thread whose block the kernel stack pointer SP
+   points into. */
+#define thread_from_sp(SP) \
+	((struct thread *) ((uint64_t) (SP) & ~((uint64_t) THREAD_STACK_SIZE - 1)))
+
 #endif /* threads/thread.h */
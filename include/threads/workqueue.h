@@ -0,0 +1,79 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <heap.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Deferred work.
+
+   Interrupt handlers, and code that runs with interrupts off or
+   holds locks, can hand work that may sleep or take a while to
+   the kernel threads of a workqueue with queue_work().  A work
+   item is a function to call with the struct work that was
+   queued, which is usually embedded in a larger structure that
+   work_entry() finds.
+
+   Queueing an item that is already pending does nothing.  Once
+   its function has started, an item may be queued again, even by
+   the function itself, so a function that may be queued while it
+   runs must be prepared to run alongside itself. */
+
+struct work;
+struct workqueue;
+typedef void work_func (struct work *);
+
+/* A work item. */
+struct work {
+	struct list_elem elem;      /* Element in workqueue's pending list. */
+	work_func *func;            /* Function to call. */
+	bool pending;               /* Queued, but not yet started? */
+};
+
+/* A work item to queue after a number of timer ticks. */
+struct delayed_work {
+	struct work work;           /* Queued when due. */
+	struct workqueue *wq;       /* Queue to put WORK on. */
+	int64_t due_tick;           /* Tick when due. */
+	struct heap_elem timer_elem; /* Element in delayed work heap. */
+	bool waiting;               /* In the delayed work heap? */
+};
+
+/* Converts pointer to work item WORK into a pointer to the
+   structure that WORK is embedded inside, whose member MEMBER it
+   is.  Like list_entry(). */
+#define work_entry(WORK, STRUCT, MEMBER)                \
+	((STRUCT *) ((uint8_t *) (WORK) - offsetof (STRUCT, MEMBER)))
+
+/* A queue of work items and the kernel threads that run them. */
+struct workqueue {
+	const char *name;           /* Name, for worker threads. */
+	struct list pending;        /* Queued work items. */
+	struct list idle;           /* Worker threads waiting for work. */
+	int nice;                   /* Nice value of worker threads. */
+};
+
+/* Workqueue for anything that does not need its own.  Work may
+   be queued on it at any time; it runs once workqueue_start()
+   has been called. */
+extern struct workqueue system_wq;
+
+void workqueue_init (void);
+void workqueue_start (void);
+void workqueue_create (struct workqueue *, const char *name,
+		int worker_cnt, int priority);
+void workqueue_create_idle (struct workqueue *, const char *name);
+
+void work_init (struct work *, work_func *);
+bool queue_work (struct workqueue *, struct work *);
+
+void delayed_work_init (struct delayed_work *, work_func *);
+bool queue_delayed_work (struct workqueue *, struct delayed_work *,
+		int64_t ticks);
+
+void workqueue_tick (int64_t now);
+int64_t workqueue_next_tick (void);
+
+#endif /* threads/workqueue.h */
@@ -1,9 +1,74 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <hash.h>
 #include "threads/thread.h"
+#include "threads/synch.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
-void set_argument(char *, char *, int, struct intr_frame *);
+/* Number of file descriptors in a process. */
+#define FD_MAX 64
+
+/* Maximum number of threads in a process, counting threads that
+   have exited but have not been joined. */
+#define PROCESS_THREAD_MAX 16
+
+/* Distance between the tops of the user stacks of consecutive
+   thread slots.  Slot 0, the first thread's, starts at USER_STACK. */
+#define THREAD_STACK_STRIDE (1 << 20)
+
+/* A thread slot, as thread_join() sees it. */
+struct process_thread {
+	tid_t tid;                          /* Thread in slot, or 0 if free. */
+	bool exited;                        /* Exited, but not yet joined? */
+};
+
+/* A process as an entry in its parent's table of children. */
+struct process_child {
+	tid_t pid;                          /* Process identifier. */
+	struct hash_elem elem;              /* Element in parent's children. */
+	struct list_elem wait_elem;         /* Element in parent's waits. */
+};
+
+/* A user process: what all of its threads share.
+
+   Each thread of the process holds a reference to it through its
+   `process' member, and so does the parent while it has not
+   waited for the process.  The address space, file descriptors
+   and children are torn down when the last thread exits; the
+   structure itself, which then holds only the exit status, is
+   freed when the last reference goes away.  Until then it stays
+   in its parent's children, so that the parent can collect the
+   exit status. */
+struct process {
+	struct process_child child;         /* Identifier and parent's entry. */
+	int ref_cnt;                        /* Number of references. */
+	struct lock lock;                   /* Protects members below. */
+
+	/* Address space. */
+	uint64_t *pml4;                     /* Page map level 4. */
+#ifdef VM
+	struct supplemental_page_table spt; /* Supplemental page table. */
+#endif
+
+	/* Open files.  Read under RCU; see fd_lookup() in syscall.c. */
+	struct file *file_table[FD_MAX];
+	int fd;                             /* Next descriptor to hand out. */
+
+	/* Threads. */
+	struct process_thread threads[PROCESS_THREAD_MAX];
+	int thread_cnt;                     /* Number of live threads. */
+	struct condition thread_exited;     /* Signaled when a thread exits. */
+	bool exiting;                       /* Called exit()? */
+
+	/* Children, and this process as a child. */
+	struct hash children;               /* Child processes, by pid. */
+	struct list waits;                  /* Children being waited for. */
+	int exit_status;                    /* Status passed to exit(). */
+	struct semaphore wait_sema;         /* Upped when last thread exits. */
+};
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
@@ -11,5 +76,10 @@ int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
+bool process_exiting (void);
+void process_terminate (int status);
+
+tid_t process_thread_create (uint64_t rip, uint64_t arg0, uint64_t arg1);
+int process_thread_join (tid_t);
 
 #endif /* userprog/process.h */
@@ -2,5 +2,6 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void syscall_init_ap (void);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,177 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every node is less than or
+   equal to all of its children.  The children of a node are kept
+   in a doubly linked sibling list: a node's `child' points to its
+   leftmost child, `next' to its right sibling, and `prev' to its
+   left sibling, or to its parent if it is the leftmost child.
+   The root has null `next' and `prev'.
+
+   Two heaps are "melded" by making the root with the larger key
+   the leftmost child of the other.  Removing the root leaves a
+   list of subtrees, which are melded back together in two passes:
+   first left to right in pairs, then the pairs right to left.
+   The passes are iterative so that large heaps cannot overflow
+   the small kernel stack. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+static bool elem_less (struct heap *,
+		const struct heap_elem *, const struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->elem_cnt = 0;
+	heap->next_seq = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	elem->seq = heap->next_seq++;
+	heap->root = meld (heap, heap->root, elem);
+	heap->elem_cnt++;
+}
+
+/* Returns the minimum element in HEAP.  Undefined behavior if
+   HEAP is empty. */
+struct heap_elem *
+heap_min (struct heap *heap) {
+	ASSERT (!heap_empty (heap));
+	return heap->root;
+}
+
+/* Removes and returns the minimum element in HEAP.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop_min (struct heap *heap) {
+	struct heap_elem *min = heap_min (heap);
+
+	heap->root = merge_pairs (heap, min->child);
+	heap->elem_cnt--;
+	min->child = NULL;
+	return min;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (!heap_empty (heap));
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop_min (heap);
+		return;
+	}
+
+	/* Unlink ELEM's subtree from its parent's child list. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+	elem->next = elem->prev = NULL;
+
+	/* Meld ELEM's children back into the rest of the heap. */
+	heap->root = meld (heap, heap->root, merge_pairs (heap, elem->child));
+	heap->elem_cnt--;
+	elem->child = NULL;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (struct heap *heap) {
+	return heap->elem_cnt;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap) {
+	return heap->root == NULL;
+}
+
+/* Melds the heaps rooted at A and B, either of which may be null,
+   and returns the new root.  A and B must not have siblings. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (elem_less (heap, b, a)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* Make B the leftmost child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Returns true if A orders before B in HEAP: A is less than B, or
+   they are equal and A was pushed first. */
+static bool
+elem_less (struct heap *heap,
+		const struct heap_elem *a, const struct heap_elem *b) {
+	if (heap->less (a, b, heap->aux))
+		return true;
+	if (heap->less (b, a, heap->aux))
+		return false;
+	return a->seq < b->seq;
+}
+
+/* Melds the sibling list starting at FIRST into a single heap and
+   returns its root, or null if FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass: meld adjacent pairs, left to right, and collect
+	   the results in reverse order through their `next' links. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+
+		a = meld (heap, a, b);
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Second pass: meld the pairs right to left. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+
+		pairs->next = NULL;
+		root = meld (heap, root, pairs);
+		pairs = next;
+	}
+	return root;
+}
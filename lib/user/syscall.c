@@ -1,5 +1,6 @@
 #include <syscall.h>
 #include <stdint.h>
+#include <thread.h>
 #include "../syscall-nr.h"
 
 __attribute__((always_inline))
@@ -194,3 +195,31 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+futex (int *addr, int op, int val) {
+	return syscall3 (SYS_FUTEX, addr, op, val);
+}
+
+/* Where threads made by thread_create() start out. */
+static void NO_RETURN
+thread_start (thread_func *func, void *aux) {
+	func (aux);
+	thread_exit ();
+}
+
+tid_t
+thread_create (thread_func *func, void *aux) {
+	return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void) {
+	syscall0 (SYS_THREAD_EXIT);
+	NOT_REACHED ();
+}
@@ -0,0 +1,158 @@
+/* Checks that the load balancer spreads a CPU-bound fan-out over
+   the CPUs.  The same total amount of busy work is done first by
+   a single thread and then split evenly among 2, 4, and 8
+   threads.  With N CPUs online, a fan-out of W threads must have
+   done work on at least min(W, N) CPUs.  With more than one CPU
+   it must also take at most three quarters as long as the single
+   thread, and with one CPU at most a quarter longer.  The margins
+   are wide because under an emulator the virtual CPUs are
+   time-sliced host threads.
+
+   balance-fanout-smp runs the same test on 4 CPUs. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Rough length of the single-threaded run, in timer ticks. */
+#define SERIAL_TICKS 100
+
+/* Busy loop iterations between progress reports. */
+#define CHUNK 1000
+
+#define MAX_WORKERS 8
+
+static int64_t chunks_per_tick (void);
+static int64_t run_fanout (int worker_cnt, int64_t chunk_cnt);
+static thread_func worker;
+
+/* Work assigned to each worker thread. */
+static int64_t worker_chunks;
+
+/* Number of chunks of work done on each of cpus[]. */
+static int64_t cpu_chunks[CPU_MAX];
+
+/* Signaled by each worker when done. */
+static struct semaphore done;
+
+void
+test_balance_fanout (void)
+{
+  int64_t total_chunks = chunks_per_tick () * SERIAL_TICKS;
+  int64_t serial;
+  int worker_cnt;
+
+  sema_init (&done, 0);
+
+  serial = run_fanout (1, total_chunks);
+  msg ("%d CPU(s) online.", cpu_cnt);
+
+  for (worker_cnt = 2; worker_cnt <= MAX_WORKERS; worker_cnt *= 2)
+    {
+      int64_t elapsed = run_fanout (worker_cnt, total_chunks);
+      int used = 0;
+      int cpu;
+
+      msg ("fan-out of %d threads took %"PRId64" ticks "
+           "(%"PRId64" for 1 thread).", worker_cnt, elapsed, serial);
+      for (cpu = 0; cpu < cpu_cnt; cpu++)
+        if (cpu_chunks[cpu] > 0)
+          {
+            msg ("  CPU %d did %"PRId64" of %"PRId64" chunks.",
+                 cpu, cpu_chunks[cpu], total_chunks);
+            used++;
+          }
+
+      if (used < (worker_cnt < cpu_cnt ? worker_cnt : cpu_cnt))
+        fail ("fan-out of %d threads ran on only %d of %d CPUs",
+              worker_cnt, used, cpu_cnt);
+      if (cpu_cnt > 1 && elapsed * 4 > serial * 3)
+        fail ("fan-out of %d threads on %d CPUs took %"PRId64" ticks, "
+              "not much less than %"PRId64" for 1 thread",
+              worker_cnt, cpu_cnt, elapsed, serial);
+      if (cpu_cnt == 1 && elapsed * 4 > serial * 5)
+        fail ("fan-out of %d threads took %"PRId64" ticks, "
+              "much more than %"PRId64" for 1 thread",
+              worker_cnt, elapsed, serial);
+    }
+
+  pass ();
+}
+
+/* Returns how many CHUNKs of the busy loop run in one timer tick,
+   measured over 10 ticks. */
+static int64_t
+chunks_per_tick (void)
+{
+  int64_t start, chunk_cnt = 0;
+
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 10)
+    {
+      volatile int i;
+      for (i = 0; i < CHUNK; i++)
+        continue;
+      chunk_cnt++;
+    }
+  return chunk_cnt / 10 > 0 ? chunk_cnt / 10 : 1;
+}
+
+/* Splits CHUNK_CNT chunks of work among WORKER_CNT new threads,
+   waits for all of them to finish, and returns the elapsed time
+   in timer ticks. */
+static int64_t
+run_fanout (int worker_cnt, int64_t chunk_cnt)
+{
+  int64_t start;
+  int i;
+
+  worker_chunks = chunk_cnt / worker_cnt;
+  for (i = 0; i < CPU_MAX; i++)
+    cpu_chunks[i] = 0;
+
+  start = timer_ticks ();
+  for (i = 0; i < worker_cnt; i++)
+    thread_create ("worker", PRI_DEFAULT, worker, NULL);
+  for (i = 0; i < worker_cnt; i++)
+    sema_down (&done);
+  return timer_elapsed (start);
+}
+
+static void
+worker (void *aux UNUSED)
+{
+  int64_t chunks[CPU_MAX] = { 0 };
+  enum intr_level old_level;
+  int64_t n;
+  int cpu;
+
+  for (n = 0; n < worker_chunks; n++)
+    {
+      volatile int i;
+
+      for (i = 0; i < CHUNK; i++)
+        continue;
+
+      /* Counted locally, so as not to take the interrupt lock,
+         which all CPUs share, in the loop.  The thread may move
+         right after reading its CPU, which only misattributes a
+         chunk. */
+      chunks[thread_current ()->cpu->id]++;
+    }
+
+  old_level = intr_disable ();
+  for (cpu = 0; cpu < CPU_MAX; cpu++)
+    cpu_chunks[cpu] += chunks[cpu];
+  intr_set_level (old_level);
+  sema_up (&done);
+}
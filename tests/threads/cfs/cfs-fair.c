@@ -0,0 +1,100 @@
+/* Checks that the fair scheduler divides the CPU in proportion
+   to the weights of the threads' nice values.
+
+   The cfs-fair test runs 3 threads all niced to 0.  The threads
+   should all receive approximately the same number of ticks.
+   Each test runs for 30 seconds, so the ticks should also sum to
+   approximately 30 * 100 == 3000 ticks.
+
+   The cfs-nice test runs 3 threads with nice 0, 2, and 5, whose
+   weights are 1024, 655, and 335, so they should receive about
+   1,525, 976, and 499 ticks, respectively, over 30 seconds.
+
+   (The expected counts are computed in cfs.pm.)  The shares only
+   hold among threads on one CPU, so the test is run on one. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_cfs_shares (int thread_cnt, const int nice[]);
+
+void
+test_cfs_fair (void) 
+{
+  static const int nice[] = {0, 0, 0};
+  test_cfs_shares (3, nice);
+}
+
+void
+test_cfs_nice (void) 
+{
+  static const int nice[] = {0, 2, 5};
+  test_cfs_shares (3, nice);
+}
+
+#define MAX_THREAD_CNT 3
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int nice;
+  };
+
+static void load_thread (void *aux);
+
+static void
+test_cfs_shares (int thread_cnt, const int nice[])
+{
+  struct thread_info info[MAX_THREAD_CNT];
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_cfs);
+  ASSERT (thread_cnt <= MAX_THREAD_CNT);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", thread_cnt);
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+      ti->nice = nice[i];
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+  msg ("Starting threads took %"PRId64" ticks.", timer_elapsed (start_time));
+
+  msg ("Sleeping 40 seconds to let threads run, please wait...");
+  timer_sleep (40 * TIMER_FREQ);
+  
+  for (i = 0; i < thread_cnt; i++)
+    msg ("Thread %d received %d ticks.", i, info[i].tick_count);
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 5 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 30 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_nice (ti->nice);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
@@ -0,0 +1,95 @@
+/* Checks admission control for the deadline class.  Each CPU
+   takes three threads that ask for 30% of it, but not a fourth,
+   and a thread that leaves the class makes room for another.
+   Parameters out of range, or asking for more than any one CPU
+   can give, are refused outright. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define MS_TO_NS(MS) ((MS) * 1000LL * 1000)
+
+#define PERIOD_NS MS_TO_NS (100)
+#define RUNTIME_NS MS_TO_NS (30)
+
+static bool try_admit (void);
+static thread_func admitter;
+
+/* Result of the last admitter. */
+static bool admitted;
+
+/* Upped by each admitter once it has set ADMITTED. */
+static struct semaphore reported;
+
+/* Upped to make one admitted admitter leave. */
+static struct semaphore release;
+
+/* Upped by each admitted admitter as it leaves. */
+static struct semaphore done;
+
+void
+test_edf_admit (void)
+{
+  int expected = 3 * cpu_cnt;
+  int i;
+
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&reported, 0);
+  sema_init (&release, 0);
+  sema_init (&done, 0);
+
+  if (thread_set_deadline (0, PERIOD_NS, PERIOD_NS)
+      || thread_set_deadline (RUNTIME_NS, RUNTIME_NS / 2, PERIOD_NS)
+      || thread_set_deadline (RUNTIME_NS, PERIOD_NS, PERIOD_NS / 2))
+    fail ("parameters out of range admitted");
+  if (thread_set_deadline (MS_TO_NS (99), PERIOD_NS, PERIOD_NS))
+    fail ("99%% of a CPU admitted");
+
+  for (i = 0; i < expected; i++)
+    if (!try_admit ())
+      fail ("only %d of %d threads admitted", i, expected);
+  if (try_admit ())
+    fail ("more than %d threads admitted", expected);
+  msg ("admitted 3 threads per CPU.");
+
+  sema_up (&release);
+  sema_down (&done);
+  if (!try_admit ())
+    fail ("no room after a thread left the class");
+  msg ("admitted another after one left.");
+
+  for (i = 0; i < expected; i++)
+    sema_up (&release);
+  for (i = 0; i < expected; i++)
+    sema_down (&done);
+  pass ();
+}
+
+/* Starts an admitter and returns whether it was admitted. */
+static bool
+try_admit (void)
+{
+  thread_create ("admitter", PRI_DEFAULT, admitter, NULL);
+  sema_down (&reported);
+  return admitted;
+}
+
+/* Asks for RUNTIME_NS of every PERIOD_NS and reports the result.
+   If admitted, stays in the class until released. */
+static void
+admitter (void *aux UNUSED)
+{
+  admitted = thread_set_deadline (RUNTIME_NS, PERIOD_NS, PERIOD_NS);
+  sema_up (&reported);
+  if (admitted)
+    {
+      sema_down (&release);
+      thread_clear_deadline ();
+      sema_up (&done);
+    }
+}
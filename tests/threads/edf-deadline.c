@@ -0,0 +1,91 @@
+/* Runs a periodic deadline thread against CPU-bound threads at
+   PRI_MAX, one more of them than there are CPUs, so that every
+   CPU is busy.  The deadline thread asks for RUNTIME_NS of every
+   PERIOD_NS and runs a JOB_NS job at the start of each of
+   JOB_CNT periods.  Since deadline threads run ahead of every
+   priority, each job should finish by its deadline even though
+   the thread's own priority is only PRI_DEFAULT. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MS_TO_NS(MS) ((MS) * 1000LL * 1000)
+
+#define PERIOD_NS MS_TO_NS (50)
+#define RUNTIME_NS MS_TO_NS (20)
+#define JOB_NS MS_TO_NS (5)
+#define JOB_CNT 20
+
+static thread_func spinner;
+
+/* Set to stop the spinners. */
+static volatile bool stop;
+
+/* Signaled by each spinner when done. */
+static struct semaphore done;
+
+void
+test_edf_deadline (void)
+{
+  int spinner_cnt = cpu_cnt + 1;
+  int64_t worst_slack = INT64_MAX;
+  int missed = 0;
+  int job, i;
+
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  stop = false;
+
+  /* Join the deadline class before starting the spinners, which
+     would otherwise keep this thread from running at all. */
+  if (!thread_set_deadline (RUNTIME_NS, PERIOD_NS, PERIOD_NS))
+    fail ("deadline thread not admitted");
+  for (i = 0; i < spinner_cnt; i++)
+    thread_create ("spinner", PRI_MAX, spinner, NULL);
+
+  for (job = 0; job < JOB_CNT; job++)
+    {
+      int64_t start, deadline, slack;
+
+      /* Start each job at the beginning of a period. */
+      thread_deadline_yield ();
+
+      deadline = thread_current ()->dl_abs_deadline;
+      start = timer_ns ();
+      while (timer_ns () - start < JOB_NS)
+        barrier ();
+
+      slack = deadline - timer_ns ();
+      if (slack < 0)
+        missed++;
+      if (slack < worst_slack)
+        worst_slack = slack;
+    }
+
+  stop = true;
+  thread_clear_deadline ();
+  for (i = 0; i < spinner_cnt; i++)
+    sema_down (&done);
+
+  msg ("%d jobs against %d spinners, worst slack %"PRId64" us.",
+       JOB_CNT, spinner_cnt, worst_slack / 1000);
+  if (missed != 0)
+    fail ("%d of %d jobs missed their deadlines", missed, JOB_CNT);
+  pass ();
+}
+
+static void
+spinner (void *aux UNUSED)
+{
+  while (!stop)
+    barrier ();
+  sema_up (&done);
+}
@@ -0,0 +1,98 @@
+/* Checks kernel_fpu_begin() and kernel_fpu_end().  Two kernel
+   threads of equal priority take turns using SSE inside a
+   begin/end pair.  Each loads XMM0 with a pattern of its own,
+   then spins for longer than a time slice, so that the timer
+   asks for a preemption while it is inside the region.  XMM0
+   must still hold the pattern afterward, and on one CPU the
+   other thread must not have run in between.  The preemption is
+   instead taken at kernel_fpu_end(), so the threads must also
+   have taken turns between regions. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2
+#define ROUND_CNT 10
+
+/* Timer ticks to spin inside each region.  Longer than the
+   scheduler's time slice of 4 ticks. */
+#define SPIN_TICKS 6
+
+static thread_func fpu_thread;
+
+/* Thread that most recently entered a region. */
+static volatile int region_owner = -1;
+
+/* Number of times a thread found the other thread had entered a
+   region since its own last one. */
+static int turn_cnt;
+
+/* Number of regions in which XMM0 or the region owner changed. */
+static int bad_cnt;
+
+static struct semaphore done;
+
+void
+test_fpu_kernel (void)
+{
+  int i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "fpu %d", i);
+      thread_create (name, PRI_DEFAULT, fpu_thread, (void *) (intptr_t) i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  if (bad_cnt != 0)
+    fail ("%d of %d regions saw their SSE state change",
+          bad_cnt, THREAD_CNT * ROUND_CNT);
+  if (turn_cnt == 0)
+    fail ("threads never took turns between regions");
+  msg ("PASS");
+}
+
+static void
+fpu_thread (void *id_)
+{
+  int id = (intptr_t) id_;
+  int round;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      uint8_t pattern[16], actual[16];
+      int64_t start;
+      size_t i;
+
+      for (i = 0; i < sizeof pattern; i++)
+        pattern[i] = id * 0x40 + round * 0x10 + i;
+
+      kernel_fpu_begin ();
+      if (region_owner != -1 && region_owner != id)
+        turn_cnt++;
+      region_owner = id;
+      asm volatile ("movdqu %0, %%xmm0" : : "m" (pattern));
+
+      start = timer_ticks ();
+      while (timer_elapsed (start) < SPIN_TICKS)
+        barrier ();
+
+      asm volatile ("movdqu %%xmm0, %0" : "=m" (actual));
+      if (memcmp (pattern, actual, sizeof pattern)
+          || (cpu_cnt == 1 && region_owner != id))
+        bad_cnt++;
+      kernel_fpu_end ();
+    }
+  sema_up (&done);
+}
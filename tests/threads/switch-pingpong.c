@@ -0,0 +1,222 @@
+/* Times thread switches.  Like sema_self_test(), the main thread
+   and a helper thread hand control back and forth through two
+   semaphores, but for a million round trips, each of which takes
+   two thread switches.  Reports the elapsed time and the TSC
+   cycles per switch; passes if every handoff arrived.
+
+   For comparison, the same run also bounces a million times
+   between the main thread and a bare helper stack, with
+   interrupts off, first through the old switch path, which saved
+   every register into an intr_frame and entered the other side
+   with do_iret(), and then through switch_context(), and reports
+   the cycles per switch of each. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/flags.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/switch.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define ITERS 1000000
+
+static thread_func pong;
+static uint64_t time_iret_switches (void *stack);
+static uint64_t time_context_switches (void *stack);
+
+/* Number of handoffs the helper received. */
+static int pongs;
+
+void
+test_switch_pingpong (void)
+{
+  struct semaphore sema[2];
+  int64_t start_ticks;
+  uint64_t start_cycles, cycles;
+  uint64_t iret_cycles, context_cycles;
+  void *stack;
+  int i;
+
+  sema_init (&sema[0], 0);
+  sema_init (&sema[1], 0);
+  thread_create ("pong", PRI_DEFAULT, pong, &sema);
+
+  start_ticks = timer_ticks ();
+  start_cycles = rdtsc ();
+  for (i = 0; i < ITERS; i++)
+    {
+      sema_up (&sema[0]);
+      sema_down (&sema[1]);
+    }
+  cycles = rdtsc () - start_cycles;
+
+  msg ("%d round trips in %"PRId64" ticks, %"PRIu64" cycles per switch.",
+       ITERS, timer_elapsed (start_ticks), cycles / (2 * ITERS));
+  if (pongs != ITERS)
+    fail ("helper got %d handoffs, expected %d", pongs, ITERS);
+
+  stack = palloc_get_page (PAL_ASSERT);
+  iret_cycles = time_iret_switches (stack);
+  context_cycles = time_context_switches (stack);
+  palloc_free_page (stack);
+
+  msg ("Bare switches: %"PRIu64" cycles through do_iret(), "
+       "%"PRIu64" through switch_context().",
+       iret_cycles / (2 * ITERS), context_cycles / (2 * ITERS));
+  pass ();
+}
+
+static void
+pong (void *sema_)
+{
+  struct semaphore *sema = sema_;
+  int i;
+
+  for (i = 0; i < ITERS; i++)
+    {
+      sema_down (&sema[0]);
+      pongs++;
+      sema_up (&sema[1]);
+    }
+}
+
+/* Contexts of the main thread and of the bare helper, for the
+   iret path. */
+static struct intr_frame main_tf, helper_tf;
+
+/* Saved stack pointers of the main thread and of the bare
+   helper, for switch_context(). */
+static uint64_t main_rsp, helper_rsp;
+
+/* Saves every register into SAVE and enters NEXT with do_iret(),
+   the way threads used to be switched, and returns when
+   something enters SAVE. */
+static void __attribute__ ((noinline))
+iret_switch (struct intr_frame *save, struct intr_frame *next)
+{
+  uint64_t tf_cur = (uint64_t) save;
+  uint64_t tf = (uint64_t) next;
+
+  asm volatile (
+      "push %%rax\n"
+      "push %%rbx\n"
+      "push %%rcx\n"
+      "movq %0, %%rax\n"
+      "movq %1, %%rcx\n"
+      "movq %%r15, 0(%%rax)\n"
+      "movq %%r14, 8(%%rax)\n"
+      "movq %%r13, 16(%%rax)\n"
+      "movq %%r12, 24(%%rax)\n"
+      "movq %%r11, 32(%%rax)\n"
+      "movq %%r10, 40(%%rax)\n"
+      "movq %%r9, 48(%%rax)\n"
+      "movq %%r8, 56(%%rax)\n"
+      "movq %%rsi, 64(%%rax)\n"
+      "movq %%rdi, 72(%%rax)\n"
+      "movq %%rbp, 80(%%rax)\n"
+      "movq %%rdx, 88(%%rax)\n"
+      "pop %%rbx\n"
+      "movq %%rbx, 96(%%rax)\n"
+      "pop %%rbx\n"
+      "movq %%rbx, 104(%%rax)\n"
+      "pop %%rbx\n"
+      "movq %%rbx, 112(%%rax)\n"
+      "addq $120, %%rax\n"
+      "movw %%es, (%%rax)\n"
+      "movw %%ds, 8(%%rax)\n"
+      "addq $32, %%rax\n"
+      "call 1f\n"
+      "1:\n"
+      "pop %%rbx\n"
+      "addq $(2f - 1b), %%rbx\n"
+      "movq %%rbx, 0(%%rax)\n"
+      "movw %%cs, 8(%%rax)\n"
+      "pushfq\n"
+      "popq %%rbx\n"
+      "mov %%rbx, 16(%%rax)\n"
+      "mov %%rsp, 24(%%rax)\n"
+      "movw %%ss, 32(%%rax)\n"
+      "mov %%rcx, %%rdi\n"
+      "call do_iret\n"
+      "2:\n"
+      : : "g" (tf_cur), "g" (tf) : "memory");
+}
+
+/* Bare helper for the iret path: switches straight back to the
+   main thread, forever. */
+static void
+iret_helper (void)
+{
+  for (;;)
+    iret_switch (&helper_tf, &main_tf);
+}
+
+/* Bare helper for switch_context(): switches straight back to
+   the main thread, forever. */
+static void
+context_helper (void)
+{
+  for (;;)
+    switch_context (&helper_rsp, main_rsp);
+}
+
+/* Bounces ITERS times between the running thread and a helper on
+   STACK, a page, through iret_switch(), and returns the TSC
+   cycles taken. */
+static uint64_t
+time_iret_switches (void *stack)
+{
+  enum intr_level old_level;
+  uint64_t start;
+  int i;
+
+  helper_tf = (struct intr_frame) {
+    .rip = (uintptr_t) iret_helper,
+    .cs = SEL_KCSEG,
+    .ds = SEL_KDSEG,
+    .es = SEL_KDSEG,
+    .ss = SEL_KDSEG,
+    .eflags = FLAG_MBS,
+    .rsp = (uintptr_t) stack + PGSIZE - sizeof (void *),
+  };
+
+  old_level = intr_disable ();
+  start = rdtsc ();
+  for (i = 0; i < ITERS; i++)
+    iret_switch (&main_tf, &helper_tf);
+  start = rdtsc () - start;
+  intr_set_level (old_level);
+  return start;
+}
+
+/* Bounces ITERS times between the running thread and a helper on
+   STACK, a page, through switch_context(), and returns the TSC
+   cycles taken. */
+static uint64_t
+time_context_switches (void *stack)
+{
+  struct switch_frame *sf;
+  enum intr_level old_level;
+  uint64_t start;
+  int i;
+
+  sf = (struct switch_frame *) ((uint8_t *) stack + PGSIZE
+                                - sizeof (void *) - sizeof *sf);
+  sf->rip = context_helper;
+  helper_rsp = (uint64_t) sf;
+
+  old_level = intr_disable ();
+  start = rdtsc ();
+  for (i = 0; i < ITERS; i++)
+    switch_context (&main_rsp, helper_rsp);
+  start = rdtsc () - start;
+  intr_set_level (old_level);
+  return start;
+}
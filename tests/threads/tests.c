@@ -29,6 +29,12 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"balance-fanout", test_balance_fanout},
+    {"balance-fanout-smp", test_balance_fanout},
+    {"switch-pingpong", test_switch_pingpong},
+    {"edf-deadline", test_edf_deadline},
+    {"edf-admit", test_edf_admit},
+    {"fpu-kernel", test_fpu_kernel},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +44,8 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"cfs-fair", test_cfs_fair},
+    {"cfs-nice", test_cfs_nice},
   };
 
 static const char *test_name;
@@ -23,6 +23,11 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_balance_fanout;
+extern test_func test_switch_pingpong;
+extern test_func test_edf_deadline;
+extern test_func test_edf_admit;
+extern test_func test_fpu_kernel;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +37,8 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_cfs_fair;
+extern test_func test_cfs_nice;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
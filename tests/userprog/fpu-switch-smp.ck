@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-switch-smp) begin
+(fpu-switch-smp) thread_create #0
+(fpu-switch-smp) thread_create #1
+(fpu-switch-smp) thread_create #2
+(fpu-switch-smp) thread_create #3
+(fpu-switch-smp) thread_join #0
+(fpu-switch-smp) thread_join #1
+(fpu-switch-smp) thread_join #2
+(fpu-switch-smp) thread_join #3
+(fpu-switch-smp) end
+fpu-switch-smp: exit(0)
+EOF
+pass;
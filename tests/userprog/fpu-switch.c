@@ -0,0 +1,128 @@
+/* Checks that each thread keeps its own FPU and SSE registers.
+   The main thread and THREAD_CNT other threads each load XMM0
+   through XMM7 and the top of the x87 stack with values of their
+   own, then spin long enough to be switched out many times,
+   checking every so often that the values are still there.  The
+   main thread also makes system calls and sleeps in between.
+   fpu-switch-smp runs the same test on 2 CPUs, so that threads
+   also move between CPUs with their state. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ROUNDS 100
+#define SPIN 100000
+
+/* FPU and SSE state that a thread loads. */
+struct fpu_state 
+  {
+    uint8_t xmm[8][16];         /* XMM0 through XMM7. */
+    int x87;                    /* Top of x87 stack, as an integer. */
+  };
+
+/* Number of checks that found a thread's state changed, by
+   thread, with the main thread last. */
+static int bad_cnt[THREAD_CNT + 1];
+
+static void
+make_state (struct fpu_state *s, int id) 
+{
+  int i, j;
+
+  for (i = 0; i < 8; i++)
+    for (j = 0; j < 16; j++)
+      s->xmm[i][j] = (id + 1) * 37 + i * 16 + j;
+  s->x87 = id * 1000 + 7;
+}
+
+static void
+load_state (const struct fpu_state *s) 
+{
+  asm volatile ("movdqu 0(%0), %%xmm0\n\t"
+                "movdqu 16(%0), %%xmm1\n\t"
+                "movdqu 32(%0), %%xmm2\n\t"
+                "movdqu 48(%0), %%xmm3\n\t"
+                "movdqu 64(%0), %%xmm4\n\t"
+                "movdqu 80(%0), %%xmm5\n\t"
+                "movdqu 96(%0), %%xmm6\n\t"
+                "movdqu 112(%0), %%xmm7\n\t"
+                "fninit\n\t"
+                "fildl %1"
+                : : "r" (s->xmm), "m" (s->x87) : "memory");
+}
+
+static void
+save_state (struct fpu_state *s) 
+{
+  asm volatile ("movdqu %%xmm0, 0(%1)\n\t"
+                "movdqu %%xmm1, 16(%1)\n\t"
+                "movdqu %%xmm2, 32(%1)\n\t"
+                "movdqu %%xmm3, 48(%1)\n\t"
+                "movdqu %%xmm4, 64(%1)\n\t"
+                "movdqu %%xmm5, 80(%1)\n\t"
+                "movdqu %%xmm6, 96(%1)\n\t"
+                "movdqu %%xmm7, 112(%1)\n\t"
+                "fistl %0"
+                : "=m" (s->x87) : "r" (s->xmm) : "memory");
+}
+
+/* Returns true if the FPU and SSE registers still hold
+   EXPECTED. */
+static bool
+check_state (const struct fpu_state *expected) 
+{
+  struct fpu_state actual;
+
+  save_state (&actual);
+  return (!memcmp (actual.xmm, expected->xmm, sizeof actual.xmm)
+          && actual.x87 == expected->x87);
+}
+
+static void
+spinner (void *id_) 
+{
+  int id = (int *) id_ - bad_cnt;
+  struct fpu_state state;
+  int round;
+
+  make_state (&state, id);
+  load_state (&state);
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      volatile int i;
+
+      for (i = 0; i < SPIN; i++)
+        continue;
+      if (!check_state (&state))
+        bad_cnt[id]++;
+    }
+}
+
+void
+test_main (void) 
+{
+  struct fpu_state state;
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  make_state (&state, THREAD_CNT);
+  load_state (&state);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (spinner, &bad_cnt[i])) != TID_ERROR,
+           "thread_create #%d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "thread_join #%d", i);
+  if (!check_state (&state))
+    bad_cnt[THREAD_CNT]++;
+
+  for (i = 0; i <= THREAD_CNT; i++)
+    if (bad_cnt[i] != 0)
+      fail ("thread #%d found its FPU state changed %d times",
+            i, bad_cnt[i]);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-switch) begin
+(fpu-switch) thread_create #0
+(fpu-switch) thread_create #1
+(fpu-switch) thread_create #2
+(fpu-switch) thread_create #3
+(fpu-switch) thread_join #0
+(fpu-switch) thread_join #1
+(fpu-switch) thread_join #2
+(fpu-switch) thread_join #3
+(fpu-switch) end
+fpu-switch: exit(0)
+EOF
+pass;
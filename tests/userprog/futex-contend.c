@@ -0,0 +1,97 @@
+/* Compares the futex-based mutex in lib/user/mutex.c with a
+   spinlock under contention.  WORKERS threads of the process each
+   take and release the same lock ITERS times, incrementing a
+   shared counter while holding it.  The spinlock just retries a
+   compare-and-swap.  The test reports how many TSC cycles each
+   took, and passes if neither lost an increment. */
+
+#include <mutex.h>
+#include <stdint.h>
+#include <syscall.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WORKERS 8
+#define ITERS 2000
+
+static uint64_t run (thread_func *);
+static thread_func mutex_worker;
+static thread_func spin_worker;
+
+/* Protected by whichever lock is being tested. */
+static int counter;
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+
+/* Spinlock: 0 unlocked, 1 locked. */
+static int spin_state;
+
+void
+test_main (void) 
+{
+  uint64_t mutex_cycles, spin_cycles;
+
+  mutex_cycles = run (mutex_worker);
+  msg ("futex mutex: %d ops in %llu cycles.",
+       counter, (unsigned long long) mutex_cycles);
+  if (counter != WORKERS * ITERS)
+    fail ("futex mutex counted %d, expected %d", counter, WORKERS * ITERS);
+
+  spin_cycles = run (spin_worker);
+  msg ("spinlock: %d ops in %llu cycles.",
+       counter, (unsigned long long) spin_cycles);
+  if (counter != WORKERS * ITERS)
+    fail ("spinlock counted %d, expected %d", counter, WORKERS * ITERS);
+}
+
+/* Runs WORKERS threads of FUNC to completion and returns the
+   elapsed time in TSC cycles. */
+static uint64_t
+run (thread_func *func) 
+{
+  tid_t tids[WORKERS];
+  uint64_t start;
+  int i;
+
+  counter = 0;
+  start = __builtin_ia32_rdtsc ();
+  for (i = 0; i < WORKERS; i++)
+    if ((tids[i] = thread_create (func, NULL)) == TID_ERROR)
+      fail ("thread_create #%d failed", i);
+  for (i = 0; i < WORKERS; i++)
+    if (thread_join (tids[i]) != 0)
+      fail ("thread_join #%d failed", i);
+  return __builtin_ia32_rdtsc () - start;
+}
+
+static void
+mutex_worker (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITERS; i++)
+    {
+      mutex_lock (&mutex);
+      counter++;
+      mutex_unlock (&mutex);
+    }
+}
+
+static void
+spin_worker (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITERS; i++)
+    {
+      int c = 0;
+
+      while (!__atomic_compare_exchange_n (&spin_state, &c, 1, false,
+                                           __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED))
+        c = 0;
+      counter++;
+      __atomic_store_n (&spin_state, 0, __ATOMIC_RELEASE);
+    }
+}
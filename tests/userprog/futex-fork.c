@@ -0,0 +1,45 @@
+/* Checks that futexes are told apart by physical address.  A
+   thread sleeps on a futex.  A child forked from the process,
+   which has the futex at the same virtual address but in a page
+   of its own, then wakes that address, which must not wake the
+   sleeper, so the child's FUTEX_WAKE returns 0.  Finally the
+   process wakes the sleeper itself. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int futex_word;
+static int started;
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  __atomic_store_n (&started, 1, __ATOMIC_RELEASE);
+  while (__atomic_load_n (&futex_word, __ATOMIC_ACQUIRE) == 0)
+    futex (&futex_word, FUTEX_WAIT, 0);
+}
+
+void
+test_main (void) 
+{
+  tid_t tid;
+  pid_t pid;
+
+  CHECK ((tid = thread_create (sleeper, NULL)) != TID_ERROR,
+         "thread_create");
+  while (!__atomic_load_n (&started, __ATOMIC_ACQUIRE))
+    continue;
+
+  if ((pid = fork ("child")) == 0)
+    exit (futex (&futex_word, FUTEX_WAKE, 1));
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  CHECK (wait (pid) == 0, "wait for child, which woke no one");
+
+  __atomic_store_n (&futex_word, 1, __ATOMIC_RELEASE);
+  futex (&futex_word, FUTEX_WAKE, 1);
+  CHECK (thread_join (tid) == 0, "thread_join");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-fork) begin
+(futex-fork) thread_create
+child: exit(0)
+(futex-fork) wait for child, which woke no one
+(futex-fork) thread_join
+(futex-fork) end
+futex-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Writes two sectors' worth of data to a file, then reads it back
+   a whole sector at a time into a user buffer.  Reads of whole,
+   aligned sectors go straight from the disk into the caller's
+   buffer, so this checks that the disk driver copies the data in
+   the reading thread, where the user buffer is mapped. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_SIZE 512
+
+static char data[SECTOR_SIZE * 2];
+static char buf[SECTOR_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+  size_t i;
+
+  for (i = 0; i < sizeof data; i++)
+    data[i] = i * 7 + i / SECTOR_SIZE;
+
+  CHECK (create ("data", sizeof data), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, data, sizeof data) == (int) sizeof data,
+         "write \"data\"");
+  close (fd);
+
+  CHECK ((fd = open ("data")) > 1, "open \"data\" for verification");
+  for (i = 0; i < sizeof data / SECTOR_SIZE; i++) 
+    {
+      CHECK (read (fd, buf, SECTOR_SIZE) == SECTOR_SIZE,
+             "read sector %zu", i);
+      if (memcmp (buf, data + i * SECTOR_SIZE, SECTOR_SIZE))
+        fail ("sector %zu differs from what was written", i);
+    }
+  close (fd);
+}
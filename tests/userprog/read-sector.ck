@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(read-sector) begin
+(read-sector) create "data"
+(read-sector) open "data"
+(read-sector) write "data"
+(read-sector) open "data" for verification
+(read-sector) read sector 0
+(read-sector) read sector 1
+(read-sector) end
+read-sector: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Starts several threads that each store a value through the
+   pointer they are passed, joins them, and checks the values.
+   Also checks that a thread cannot be joined twice. */
+
+#include <syscall.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+
+static int values[THREAD_CNT];
+
+static void
+store (void *value_) 
+{
+  int *value = value_;
+  *value = value - values + 1;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (store, &values[i])) != TID_ERROR,
+           "thread_create #%d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "thread_join #%d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    if (values[i] != i + 1)
+      fail ("thread #%d stored %d, not %d", i, values[i], i + 1);
+  CHECK (thread_join (tids[0]) == -1, "thread_join #0 again");
+}
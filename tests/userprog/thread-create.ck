@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-create) begin
+(thread-create) thread_create #0
+(thread-create) thread_create #1
+(thread-create) thread_create #2
+(thread-create) thread_create #3
+(thread-create) thread_join #0
+(thread-create) thread_join #1
+(thread-create) thread_join #2
+(thread-create) thread_join #3
+(thread-create) thread_join #0 again
+(thread-create) end
+thread-create: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Calls exit() while another thread of the process sleeps in
+   FUTEX_WAIT on a futex that nobody wakes.  The sleeper must be
+   woken and exit too, or the process never finishes exiting and
+   the kernel's wait for it hangs. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int futex_word;
+static int started;
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  __atomic_store_n (&started, 1, __ATOMIC_RELEASE);
+  futex (&futex_word, FUTEX_WAIT, 0);
+  fail ("returned from FUTEX_WAIT");
+}
+
+void
+test_main (void) 
+{
+  CHECK (thread_create (sleeper, NULL) != TID_ERROR, "thread_create");
+  while (!__atomic_load_n (&started, __ATOMIC_ACQUIRE))
+    continue;
+  exit (57);
+}
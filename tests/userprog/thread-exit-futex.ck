@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit-futex) begin
+(thread-exit-futex) thread_create
+thread-exit-futex: exit(57)
+EOF
+pass;
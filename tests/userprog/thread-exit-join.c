@@ -0,0 +1,45 @@
+/* Calls exit() while one thread of the process sleeps in
+   thread_join() on another, which sleeps in FUTEX_WAIT on a futex
+   that nobody wakes.  Both must be woken and exit too, or the
+   process never finishes exiting and the kernel's wait for it
+   hangs. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include <thread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int futex_word;
+static int started;
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  futex (&futex_word, FUTEX_WAIT, 0);
+  fail ("returned from FUTEX_WAIT");
+}
+
+static void
+joiner (void *sleeper_tid_) 
+{
+  tid_t *sleeper_tid = sleeper_tid_;
+
+  __atomic_store_n (&started, 1, __ATOMIC_RELEASE);
+  thread_join (*sleeper_tid);
+  fail ("returned from thread_join");
+}
+
+void
+test_main (void) 
+{
+  static tid_t sleeper_tid;
+
+  CHECK ((sleeper_tid = thread_create (sleeper, NULL)) != TID_ERROR,
+         "thread_create sleeper");
+  CHECK (thread_create (joiner, &sleeper_tid) != TID_ERROR,
+         "thread_create joiner");
+  while (!__atomic_load_n (&started, __ATOMIC_ACQUIRE))
+    continue;
+  exit (57);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit-join) begin
+(thread-exit-join) thread_create sleeper
+(thread-exit-join) thread_create joiner
+thread-exit-join: exit(57)
+EOF
+pass;
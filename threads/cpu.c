@@ -0,0 +1,193 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/ioapic.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/tss.h"
+#endif
+
+/* Multiprocessor support.
+
+   The boot CPU (the BSP) runs main() as usual.  Once the
+   scheduler is up, smp_init() starts each application processor
+   (AP) in turn: it prepares the AP's idle thread and copies the
+   start-up code in ap-start.S below 1 MB, then wakes the AP with
+   an INIT-SIPI-SIPI sequence.  The AP switches itself to long
+   mode, lands in ap_main() on its idle thread's stack, sets up
+   its descriptor tables and local APIC, and starts scheduling.
+
+   CPUs are found through CPUID rather than the ACPI or MP
+   tables: the local APIC IDs are assumed to run from 0, the
+   boot CPU's, up to the number of logical processors in the
+   package, which is how QEMU numbers them. */
+
+/* All CPUs, indexed by id.  The boot CPU is cpus[0]. */
+struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs online.  Zero until thread_init() brings up the
+   boot CPU, which lets code that runs before then know that
+   there is no struct thread, and no struct cpu pointer in it,
+   yet. */
+int cpu_cnt;
+
+/* -smp=N: bring up at most N CPUs.  Zero means as many as CPUID
+   reports. */
+int cpu_limit;
+
+/* How long to wait for an AP to report in, in milliseconds. */
+#define AP_TIMEOUT 100
+
+#define CPUID_HTT (1 << 28)         /* CPUID.1:EDX, EBX[23:16] valid. */
+
+/* Start-up code in ap-start.S. */
+extern const char ap_trampoline[], ap_trampoline_end[];
+
+/* Handed from start_ap() to ap-start.S. */
+uint64_t ap_boot_cr3;               /* Physical address of base_pml4. */
+uint64_t ap_boot_stack;             /* Top of the AP's idle thread. */
+struct cpu *ap_boot_cpu;            /* The AP's struct cpu. */
+
+static int cpu_probe (void);
+static bool start_ap (struct cpu *);
+
+_Static_assert (offsetof (struct cpu, tss) == CPU_TSS,
+		"syscall_entry expects the TSS first in struct cpu");
+_Static_assert (offsetof (struct cpu, syscall_rbx) == CPU_SYSCALL_RBX,
+		"syscall_entry expects syscall_rbx at CPU_SYSCALL_RBX");
+_Static_assert (offsetof (struct cpu, syscall_r12) == CPU_SYSCALL_R12,
+		"syscall_entry expects syscall_r12 at CPU_SYSCALL_R12");
+
+/* Returns the CPU that the caller is running on.  Like
+   running_thread() in thread.c, this finds the running thread
+   from the stack pointer, so it works even in the middle of a
+   thread switch. */
+struct cpu *
+cpu_current (void) {
+	struct thread *t = thread_from_sp (rrsp ());
+
+	if (cpu_cnt == 0)
+		return &cpus[0];
+	return t->cpu;
+}
+
+/* Starts the boot CPU's local APIC, if it has one, moves the tick
+   and device interrupts to the APICs, and starts the application
+   processors.  Must be called by the boot CPU with interrupts on,
+   after timer_calibrate(). */
+void
+smp_init (void) {
+	int cnt = cpu_probe ();
+	int i;
+
+	if (!lapic_present ())
+		return;
+
+	lapic_init ();
+	lapic_timer_calibrate ();
+	cpus[0].lapic_id = lapic_id ();
+	timer_init_lapic ();
+
+	/* In tickless mode, the PIT still ticks through the PICs. */
+	if (!timer_tickless && ioapic_init ())
+		intr_route_ioapic ();
+
+	if (cnt <= 1)
+		return;
+
+	memcpy (ptov (AP_TRAMPOLINE), ap_trampoline,
+			ap_trampoline_end - ap_trampoline);
+
+	for (i = 1; i < cnt; i++)
+		if (!start_ap (&cpus[i]))
+			break;
+
+	printf ("SMP: %d CPUs online.\n", cpu_cnt);
+}
+
+/* Returns the number of CPUs to bring up. */
+static int
+cpu_probe (void) {
+	uint32_t eax, ebx, ecx, edx;
+	int cnt = 1;
+
+	if (!lapic_present ())
+		return 1;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_HTT)
+		cnt = (ebx >> 16) & 0xff;
+
+	if (cpu_limit > 0 && cnt > cpu_limit)
+		cnt = cpu_limit;
+	if (cnt > CPU_MAX)
+		cnt = CPU_MAX;
+	return cnt;
+}
+
+/* Starts CPU, which must not be running yet, and waits for it to
+   begin scheduling.  Returns true if successful, false if CPU
+   did not report in. */
+static bool
+start_ap (struct cpu *cpu) {
+	struct thread *idle;
+	int i;
+
+	cpu->id = cpu - cpus;
+	cpu->lapic_id = cpu->id;
+
+	/* Everything that might block is done here, on the boot CPU:
+	   an AP has no thread to block until it is scheduling. */
+	idle = thread_prepare_ap (cpu);
+	if (idle == NULL)
+		return false;
+#ifdef USERPROG
+	tss_init_ap (cpu);
+#endif
+
+	ap_boot_cr3 = vtop (base_pml4);
+	ap_boot_stack = (uint64_t) idle + THREAD_STACK_SIZE;
+	ap_boot_cpu = cpu;
+	lapic_start_ap (cpu->lapic_id, AP_TRAMPOLINE);
+
+	for (i = 0; i < AP_TIMEOUT && !cpu->started; i++)
+		timer_msleep (1);
+	if (!cpu->started) {
+		printf ("SMP: CPU %d did not start.\n", cpu->id);
+		return false;
+	}
+	cpu_cnt++;
+	return true;
+}
+
+/* Entry point of an application processor, called by ap-start.S
+   on the stack of the idle thread that start_ap() prepared, with
+   interrupts off.  Nothing here may block. */
+void
+ap_main (struct cpu *cpu) {
+	thread_init_ap ();
+	fpu_init_ap ();
+#ifdef USERPROG
+	gdt_init ();
+#endif
+	intr_init_ap ();
+#ifdef USERPROG
+	syscall_init_ap ();
+#endif
+	lapic_init_ap ();
+	lapic_timer_start (true);
+
+	cpu->started = true;
+	thread_start_ap ();
+}
@@ -0,0 +1,173 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Lazy FPU switching.
+
+   The x87, MMX and SSE registers are not part of the intr_frame
+   or of switch_context()'s frame.  Instead, every thread switch
+   sets CR0.TS, so that the next FPU or SSE instruction traps with
+   #NM.  fpu_trap(), called from the #NM handler, then loads the
+   running thread's saved state into the registers, unless they
+   still hold it.  A thread that never touches the FPU never pays
+   for it, and one that is switched out and back in with no other
+   thread using the FPU meanwhile only pays for the trap.
+
+   Each CPU's `fpu_owner' is the thread whose state its registers
+   last loaded, and each thread's `fpu_cpu' is the CPU that did
+   so; the registers are still good only if both agree.  Since a
+   thread can move between CPUs, state that a thread changed is
+   saved when it is switched out, rather than on the next trap.
+
+   The kernel itself is compiled without FPU or SSE instructions,
+   except between kernel_fpu_begin() and kernel_fpu_end(). */
+
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* Emulation. */
+#define CR0_TS 0x00000008       /* Task switched. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE, FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* SIMD exceptions raise #XF. */
+
+/* State that a thread starts with: registers as after FNINIT. */
+static uint8_t initial_state[FPU_STATE_SIZE]
+	__attribute__ ((aligned (FPU_STATE_ALIGN)));
+
+static void *fpu_area (struct thread *);
+static void enable_fpu (void);
+
+/* Enables the FPU and SSE on the bootstrap processor and records
+   the state that threads start out with. */
+void
+fpu_init (void) {
+	enable_fpu ();
+	clts ();
+	asm volatile ("fninit");
+	fxsave (initial_state);
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Enables the FPU and SSE on an application processor. */
+void
+fpu_init_ap (void) {
+	enable_fpu ();
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Handles #NM, raised by an FPU or SSE instruction while CR0.TS
+   is set: gives the running thread its FPU state, allocating it
+   on first use.  Must be called with interrupts off.  Returns
+   false if memory runs out. */
+bool
+fpu_trap (void) {
+	struct thread *t = thread_current ();
+	struct cpu *cpu;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!intr_context ());
+
+	if (t->fpu_mem == NULL) {
+		void *mem;
+
+		intr_enable ();
+		mem = malloc (FPU_STATE_SIZE + FPU_STATE_ALIGN - 1);
+		intr_disable ();
+		if (mem == NULL)
+			return false;
+
+		t->fpu_mem = mem;
+		t->fpu_cpu = NULL;
+		memcpy (fpu_area (t), initial_state, FPU_STATE_SIZE);
+	}
+
+	/* Reenabling interrupts above may have moved us. */
+	cpu = t->cpu;
+	clts ();
+	if (cpu->fpu_owner != t || t->fpu_cpu != cpu) {
+		fxrstor (fpu_area (t));
+		cpu->fpu_owner = t;
+		t->fpu_cpu = cpu;
+	}
+	return true;
+}
+
+/* Called by the scheduler with interrupts off, before switching
+   away from PREV.  If PREV used the FPU since it was switched in,
+   saves its state, then sets CR0.TS for the next thread. */
+void
+fpu_switch (struct thread *prev) {
+	uint64_t cr0 = rcr0 ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!(cr0 & CR0_TS)) {
+		if (prev->fpu_mem != NULL)
+			fxsave (fpu_area (prev));
+		lcr0 (cr0 | CR0_TS);
+	}
+}
+
+/* Frees the running thread's FPU state.  Called on thread exit. */
+void
+fpu_exit (void) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+	void *mem;
+
+	old_level = intr_disable ();
+	lcr0 (rcr0 () | CR0_TS);
+	if (t->cpu->fpu_owner == t)
+		t->cpu->fpu_owner = NULL;
+	mem = t->fpu_mem;
+	t->fpu_mem = NULL;
+	intr_set_level (old_level);
+
+	free (mem);
+}
+
+/* Lets kernel code use FPU and SSE instructions until
+   kernel_fpu_end().  Saves the running thread's own FPU state
+   first, if the registers hold it.  The thread cannot be
+   preempted in between, and it must not sleep.  Must not be
+   nested or called from an interrupt handler. */
+void
+kernel_fpu_begin (void) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+
+	thread_preempt_disable ();
+	old_level = intr_disable ();
+	if (!(rcr0 () & CR0_TS) && t->fpu_mem != NULL)
+		fxsave (fpu_area (t));
+	clts ();
+	t->cpu->fpu_owner = NULL;
+	intr_set_level (old_level);
+}
+
+/* Ends a region begun by kernel_fpu_begin().  The running thread's
+   own state is loaded again when it next uses the FPU. */
+void
+kernel_fpu_end (void) {
+	lcr0 (rcr0 () | CR0_TS);
+	thread_preempt_enable ();
+}
+
+/* Returns T's FXSAVE area, aligned within its allocation. */
+static void *
+fpu_area (struct thread *t) {
+	return (void *) ROUND_UP ((uintptr_t) t->fpu_mem, FPU_STATE_ALIGN);
+}
+
+/* Turns on the FPU and SSE on the running CPU. */
+static void
+enable_fpu (void) {
+	lcr0 ((rcr0 () & ~CR0_EM) | CR0_MP);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+}
@@ -0,0 +1,152 @@
+#include "threads/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Fast user-space mutexes.
+
+   A futex is just an int in memory.  Code built on it changes the
+   int with atomic instructions and only calls in here when it has
+   to wait, or when it knows there may be a waiter to wake, so an
+   uncontended lock never enters the kernel.
+
+   Waiters are kept in a fixed hash table of wait queues, keyed by
+   the physical address of the int, so that the same futex is
+   found whatever virtual address it is reached through.  The
+   table, and the check of the futex's value against the value the
+   waiter expects, are protected by turning interrupts off. */
+
+/* Number of hash buckets. */
+#define FUTEX_BUCKETS 64
+
+/* A thread waiting on a futex.  Lives on the waiter's stack. */
+struct futex_waiter {
+	struct list_elem elem;              /* Element in bucket. */
+	uint64_t key;                       /* Physical address of futex. */
+	const void *owner;                  /* For futex_cancel(). */
+	struct semaphore sema;              /* Upped to wake the waiter. */
+};
+
+/* Wait queues, hashed by physical address. */
+static struct list buckets[FUTEX_BUCKETS];
+
+static struct list *futex_bucket (uint64_t key);
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++)
+		list_init (&buckets[i]);
+}
+
+/* If *ADDR equals VAL, sleeps until futex_wake() is called on the
+   same futex, or futex_cancel() on OWNER, and returns true.
+   Otherwise, or if STOP is non-null and returns true, returns
+   false right away.  ADDR is a kernel virtual address; the caller
+   translates user addresses.
+
+   Checking *ADDR and STOP and queuing the caller are atomic with
+   respect to futex_wake() and futex_cancel(), so a waker that
+   changes *ADDR, or whatever STOP tests, and then calls one of
+   them cannot slip in between and leave the caller asleep. */
+bool
+futex_wait (int *addr, int val, const void *owner, bool (*stop) (void)) {
+	struct futex_waiter waiter;
+	enum intr_level old_level;
+
+	ASSERT (addr != NULL);
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	if (__atomic_load_n (addr, __ATOMIC_ACQUIRE) != val
+			|| (stop != NULL && stop ())) {
+		intr_set_level (old_level);
+		return false;
+	}
+	waiter.key = vtop (addr);
+	waiter.owner = owner;
+	sema_init (&waiter.sema, 0);
+	list_push_back (futex_bucket (waiter.key), &waiter.elem);
+	intr_set_level (old_level);
+
+	sema_down (&waiter.sema);
+	return true;
+}
+
+/* Wakes up to CNT threads waiting on the futex at ADDR, oldest
+   first, and returns the number woken.  ADDR is a kernel virtual
+   address. */
+int
+futex_wake (int *addr, int cnt) {
+	uint64_t key = vtop (addr);
+	struct list *bucket = futex_bucket (key);
+	struct list waking;
+	struct list_elem *e;
+	enum intr_level old_level;
+	int woken = 0;
+
+	ASSERT (addr != NULL);
+
+	/* Dequeue the waiters first, then wake them: sema_up() may
+	   yield, and other threads could then change the bucket. */
+	list_init (&waking);
+	old_level = intr_disable ();
+	for (e = list_begin (bucket); e != list_end (bucket) && woken < cnt; ) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		if (w->key == key) {
+			e = list_remove (e);
+			list_push_back (&waking, &w->elem);
+			woken++;
+		} else
+			e = list_next (e);
+	}
+	while (!list_empty (&waking))
+		sema_up (&list_entry (list_pop_front (&waking),
+					struct futex_waiter, elem)->sema);
+	intr_set_level (old_level);
+	return woken;
+}
+
+/* Wakes every thread waiting on any futex that passed OWNER, a
+   non-null pointer, to futex_wait().  Used to get the threads of
+   a process that is exiting out of the kernel. */
+void
+futex_cancel (const void *owner) {
+	struct list waking;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (owner != NULL);
+
+	list_init (&waking);
+	old_level = intr_disable ();
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		struct list_elem *e;
+
+		for (e = list_begin (&buckets[i]); e != list_end (&buckets[i]); ) {
+			struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+			if (w->owner == owner) {
+				e = list_remove (e);
+				list_push_back (&waking, &w->elem);
+			} else
+				e = list_next (e);
+		}
+	}
+	while (!list_empty (&waking))
+		sema_up (&list_entry (list_pop_front (&waking),
+					struct futex_waiter, elem)->sema);
+	intr_set_level (old_level);
+}
+
+/* Returns the wait queue for the futex at physical address KEY. */
+static struct list *
+futex_bucket (uint64_t key) {
+	return &buckets[hash_bytes (&key, sizeof key) % FUTEX_BUCKETS];
+}
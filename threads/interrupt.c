@@ -3,9 +3,14 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "devices/ioapic.h"
+#include "devices/lapic.h"
+#include "devices/serial.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -13,11 +18,19 @@
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
 #define INTR_CNT 256
 
+/* External interrupts come from the PICs, or from the I/O APIC in
+   their place, at 0x20...0x2f, or from the local APIC at
+   0xf0...0xff. */
+#define is_pic_vec(VEC) ((VEC) >= 0x20 && (VEC) <= 0x2f)
+#define is_lapic_vec(VEC) ((VEC) >= 0xf0)
+#define is_external_vec(VEC) (is_pic_vec (VEC) || is_lapic_vec (VEC))
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -99,14 +112,32 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU tracks this for itself in its
+   struct cpu's `in_external_intr' and `yield_on_return'. */
+
+/* Interrupt lock.
+
+   Turning interrupts off is how Pintos keeps a section of code
+   from being interleaved with any other, but on a multiprocessor
+   it only stops the calling CPU.  So every CPU that runs with
+   interrupts off also holds this lock: intr_disable() acquires
+   it, intr_enable() releases it, and intr_handler() acquires it
+   for interrupts that arrive with interrupts on.  It belongs to
+   a CPU, not a thread: a thread that blocks with interrupts off
+   passes it to the next thread on the same CPU, which releases
+   it when it turns interrupts back on. */
+static struct spinlock intr_lock;
+
+static void intr_lock_acquire (void);
+static void intr_lock_release (void);
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
 
+/* True once intr_route_ioapic() has shut off the PICs. */
+static bool pic_disabled;
+
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 
@@ -137,6 +168,8 @@ intr_enable (void) {
 	enum intr_level old_level = intr_get_level ();
 	ASSERT (!intr_context ());
 
+	intr_lock_release ();
+
 	/* Enable interrupts by setting the interrupt flag.
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -155,10 +188,43 @@ intr_disable (void) {
 	   See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory");
+	intr_lock_acquire ();
 
 	return old_level;
 }
 
+/* Enables interrupts and waits for the next one to arrive.
+
+   The `sti' instruction disables interrupts until the completion
+   of the next instruction, so `sti; hlt' is atomic: no interrupt
+   can be handled between re-enabling interrupts and waiting for
+   the next one to occur.  See [IA32-v2a] "HLT", [IA32-v2b] "STI",
+   and [IA32-v3a] 7.11.1 "HLT Instruction". */
+void
+intr_wait (void) {
+	ASSERT (!intr_context ());
+
+	intr_lock_release ();
+	asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Acquires the interrupt lock for the calling CPU, which must
+   have interrupts off, unless it already holds it.  Until
+   thread_init() sets up the boot CPU there is nothing to
+   exclude and no struct cpu to record as the owner. */
+static void
+intr_lock_acquire (void) {
+	if (cpu_cnt > 0 && !spin_held (&intr_lock))
+		spin_lock (&intr_lock);
+}
+
+/* Releases the interrupt lock if the calling CPU holds it. */
+static void
+intr_lock_release (void) {
+	if (cpu_cnt > 0 && spin_held (&intr_lock))
+		spin_unlock (&intr_lock);
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -203,6 +269,17 @@ intr_init (void) {
 	intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT, and the TSS if there is one, on an application
+   processor.  The boot CPU's intr_init() already filled in the
+   IDT, which all CPUs share. */
+void
+intr_init_ap (void) {
+#ifdef USERPROG
+	ltr (SEL_TSS);
+#endif
+	lidt (&idt_desc);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -227,8 +304,10 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external_vec (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
+	if (pic_disabled && vec_no != 0x20 && is_pic_vec (vec_no))
+		ioapic_route (vec_no - 0x20, vec_no, cpus[0].lapic_id);
 }
 
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
@@ -248,7 +327,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external_vec (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -256,7 +335,7 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
    and false at all other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	return cpu_current ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -266,7 +345,7 @@ intr_context (void) {
 void
 intr_yield_on_return (void) {
 	ASSERT (intr_context ());
-	yield_on_return = true;
+	cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -308,6 +387,41 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Masks IRQ on the PICs. */
+void
+intr_pic_mask (int irq) {
+	ASSERT (irq >= 0 && irq < 16);
+
+	if (irq < 8)
+		outb (0x21, inb (0x21) | (1 << irq));
+	else
+		outb (0xa1, inb (0xa1) | (1 << (irq - 8)));
+}
+
+/* Moves the ISA IRQs that have handlers from the PICs to the I/O
+   APIC, which ioapic_init() has set up, and shuts off the PICs.
+   They keep their vectors, 0x21...0x2f, and go to the boot CPU
+   as before.  IRQ 0, from the PIT, is left behind: the local
+   APIC timer must have taken over the tick.  Later calls to
+   intr_register_ext() route their IRQs the same way. */
+void
+intr_route_ioapic (void) {
+	enum intr_level old_level = intr_disable ();
+	int vec;
+
+	for (vec = 0x21; vec <= 0x2f; vec++)
+		if (intr_handlers[vec] != NULL)
+			ioapic_route (vec - 0x20, vec, cpus[0].lapic_id);
+	outb (0x21, 0xff);
+	outb (0xa1, 0xff);
+	pic_disabled = true;
+
+	/* A transmit interrupt that the PICs held on to is lost.
+	   Have the serial port raise another. */
+	serial_notify ();
+	intr_set_level (old_level);
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -330,27 +444,36 @@ pic_end_of_interrupt (int irq) {
    interrupted thread's registers. */
 void
 intr_handler (struct intr_frame *frame) {
+	struct cpu *cpu;
 	bool external;
 	intr_handler_func *handler;
 
+	/* Interrupt gates turn interrupts off, so take the interrupt
+	   lock that goes with that, unless the interrupted code was
+	   already running with interrupts off and holds it. */
+	if (intr_get_level () == INTR_OFF)
+		intr_lock_acquire ();
+	cpu = cpu_current ();
+
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or local APIC
+	   (see below).  An external interrupt handler cannot sleep. */
+	external = is_external_vec (frame->vec_no);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
 
-		in_external_intr = true;
-		yield_on_return = false;
+		cpu->in_external_intr = true;
+		cpu->yield_on_return = false;
 	}
 
 	/* Invoke the interrupt's handler. */
 	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
 		handler (frame);
-	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+			|| frame->vec_no == LAPIC_SPURIOUS_VEC) {
 		/* There is no handler, but this interrupt can trigger
 		   spuriously due to a hardware fault or hardware race
 		   condition.  Ignore it. */
@@ -366,12 +489,29 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (intr_context ());
 
-		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		cpu->in_external_intr = false;
+		if (is_pic_vec (frame->vec_no) && !pic_disabled)
+			pic_end_of_interrupt (frame->vec_no);
+		else if (frame->vec_no != LAPIC_SPURIOUS_VEC)
+			lapic_eoi ();
 
-		if (yield_on_return)
-			thread_yield ();
+		if (cpu->yield_on_return)
+			thread_preempt ();
 	}
+
+#ifdef USERPROG
+	/* Don't return to user mode in a process that is exiting;
+	   this catches threads that never make a system call. */
+	if (frame->cs == SEL_UCSEG && process_exiting ()) {
+		intr_enable ();
+		thread_exit ();
+	}
+#endif
+
+	/* Returning to code that runs with interrupts on: iretq will
+	   turn them back on, so drop the interrupt lock. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_lock_release ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
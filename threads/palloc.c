@@ -7,10 +7,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,24 +27,129 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 2**ORDER pages,
+   each aligned to its own size, on one free list per order.  A
+   request for N pages takes the smallest free block of at least
+   N pages, splits it in halves down to the smallest order that
+   holds N, and gives back the pages beyond N.  A block that is
+   freed is merged with its "buddy", the other half of the block
+   of the next order up, for as long as the buddy is free too.
+   Either takes time proportional to the number of orders, not
+   to the size of the pool.  Pages can be freed in any pieces,
+   not only as they were allocated: a range that is freed is
+   split into the largest aligned blocks that it contains.
+
+   The free lists are linked through an array with an entry per
+   page, rather than through the free pages themselves, so that
+   the allocator touches no page that it does not hand out.  The
+   used_map bitmap still records which pages are allocated, to
+   catch pages that are freed twice.
+
+   Single pages are allocated and freed through a small
+   "magazine" of free pages per CPU in front of each pool, which
+   the CPU's own threads use with only preemption disabled, so
+   that most single-page requests take no lock shared with other
+   CPUs.  An empty magazine is refilled, and a full one drained,
+   MAG_BATCH pages at a time under the pool lock.  Pages in a
+   magazine are allocated as far as the pool is concerned, so a
+   pool that is running low only hands out one page at a time,
+   to keep them from sitting unused in other CPUs' magazines.
+   If the pool runs out anyway, the request drains every CPU's
+   magazine back into the pool and tries again.  Each magazine
+   has a flag that its CPU holds while using it, so that another
+   CPU can drain it safely; the flag is almost never contended.
+
+   Each pool also keeps a supply of pages that were zeroed in
+   advance, so that single-page PAL_ZERO requests need not zero a
+   page while the caller waits; they zero one themselves only if
+   the supply has run out.  The supply is refilled with free pages
+   by the "pagezero" kernel thread, an idle workqueue worker (see
+   workqueue_create_idle()), so that zeroing takes time that would
+   otherwise go idle.  These pages
+   are allocated as far as the buddy allocator is concerned, so
+   the refill stops when the pool runs low, and a multi-page
+   request that finds no block big enough returns them to the
+   buddy allocator before trying again.  Each is linked into
+   the pool's `zeroed' list, which has its own lock, through a
+   list_elem at its start, which is cleared when the page is
+   handed out. */
+
+/* Bounds on the number of pages in a pool's zeroed list. */
+#define ZEROED_LOW 16               /* Refill below this many. */
+#define ZEROED_HIGH 64              /* Refill up to this many. */
+
+/* Buddy allocator orders: blocks of 1 to 2**(ORDER_CNT - 1)
+   pages. */
+#define ORDER_CNT 11
+
+/* `order' of a page that does not begin a free block. */
+#define ORDER_NONE 0xff
+
+/* Per-CPU magazines. */
+#define MAG_SIZE 16                 /* Pages in a full magazine. */
+#define MAG_BATCH 8                 /* Pages moved to or from pool at once. */
+#define MAG_RESERVE (CPU_MAX * MAG_SIZE) /* Refill one page at a time
+                                       below this many free pages. */
+
+/* A CPU's magazine of free pages from one pool. */
+struct magazine {
+	void *pages[MAG_SIZE];          /* Free pages. */
+	int cnt;                        /* Number of pages in PAGES. */
+	long long alloc_hits;           /* # of allocations from PAGES. */
+	long long alloc_misses;         /* # of allocations that refilled. */
+	long long free_hits;            /* # of frees into PAGES. */
+	long long free_misses;          /* # of frees that drained. */
+	volatile int busy;              /* 1 while PAGES is in use. */
+};
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	struct list free[ORDER_CNT];    /* Free blocks of each order. */
+	uint32_t free_mask;             /* Orders with free blocks. */
+	struct list_elem *links;        /* Per page: element in free[]. */
+	uint8_t *order;                 /* Per page: order of free block
+	                                   it begins, or ORDER_NONE. */
+	size_t free_cnt;                /* Number of pages in free[]. */
+	struct magazine mags[CPU_MAX];  /* Indexed by cpu->id. */
+	struct lock zero_lock;          /* Protects members below. */
+	struct list zeroed;             /* Pages zeroed in advance. */
+	size_t zeroed_cnt;              /* Number of pages in ZEROED. */
+	long long zeroed_hits;          /* # of pages taken from ZEROED. */
+	long long zeroed_misses;        /* # of times ZEROED was empty. */
+	struct work zero_work;          /* Refills ZEROED. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Runs the pools' zero_work, once palloc_start() has been
+   called. */
+static struct workqueue zero_wq;
+static bool zero_started;
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void *mag_alloc (struct pool *);
+static void mag_free (struct pool *, void *page);
+static void mag_lock (struct magazine *);
+static void mag_unlock (struct magazine *);
+static void drain_magazines (struct pool *);
+static void drain_zeroed (struct pool *);
+static void *alloc_block (struct pool *, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static void refill_zeroed (struct work *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +331,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,16 +370,36 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = take_zeroed (pool);
+		if (pages != NULL)
+			return pages;
+	}
+
+	if (page_cnt == 1) {
+		pages = mag_alloc (pool);
+		if (pages == NULL) {
+			/* Out of free pages, but there may be zeroed ones left,
+			   or free ones in other CPUs' magazines. */
+			pages = take_zeroed (pool);
+			if (pages != NULL)
+				return pages;
+			drain_magazines (pool);
+			pages = mag_alloc (pool);
+		}
+	} else {
+		pages = alloc_block (pool, page_cnt);
+		if (pages == NULL) {
+			/* The buddy allocator cannot merge pages that sit in
+			   magazines or in the zeroed list into a block, so give
+			   them back to it and try once more. */
+			drain_magazines (pool);
+			drain_zeroed (pool);
+			pages = alloc_block (pool, page_cnt);
+		}
+	}
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -318,8 +446,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1) {
+		mag_free (pool, pages);
+		return;
+	}
+	lock_acquire (&pool->lock);
+	buddy_free (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -328,18 +461,76 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Starts the thread that zeroes pages in advance, and fills the
+   pools' zeroed lists.  Call after thread_start(). */
+void
+palloc_start (void) {
+	workqueue_create_idle (&zero_wq, "pagezero");
+	zero_started = true;
+	queue_work (&zero_wq, &kernel_pool.zero_work);
+	queue_work (&zero_wq, &user_pool.zero_work);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	size_t i;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		long long alloc_hits = 0, alloc_misses = 0;
+		long long free_hits = 0, free_misses = 0;
+		int cpu;
+
+		/* The counts may be slightly stale, which is fine here. */
+		for (cpu = 0; cpu < CPU_MAX; cpu++) {
+			const struct magazine *m = &pools[i]->mags[cpu];
+
+			alloc_hits += m->alloc_hits;
+			alloc_misses += m->alloc_misses;
+			free_hits += m->free_hits;
+			free_misses += m->free_misses;
+		}
+		printf ("Palloc: %s pool: %lld alloc hits, %lld alloc misses, "
+				"%lld free hits, %lld free misses, "
+				"%lld zeroed hits, %lld zeroed misses\n",
+				pools[i] == &kernel_pool ? "kernel" : "user",
+				alloc_hits, alloc_misses, free_hits, free_misses,
+				pools[i]->zeroed_hits, pools[i]->zeroed_misses);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map, and the per-page arrays of the
+     buddy allocator, at *BM_BASE.  Calculate the space needed for
+     them and advance *BM_BASE past it. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
-
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	size_t links_size = pgcnt * sizeof *p->links;
+	size_t order_size = ROUND_UP (pgcnt, sizeof (void *));
+	size_t bm_size = bitmap_buf_size (pgcnt);
+	size_t bm_pages = DIV_ROUND_UP (links_size + order_size + bm_size, PGSIZE)
+		* PGSIZE;
+	uint8_t *buf = *bm_base;
+	int i;
+
+	lock_init_adaptive (&p->lock, p == &kernel_pool ? "kernel pool" : "user pool");
+	p->links = (struct list_elem *) buf;
+	p->order = buf + links_size;
+	p->used_map = bitmap_create_in_buf (pgcnt, buf + links_size + order_size,
+			bm_size);
 	p->base = (void *) start;
+	for (i = 0; i < ORDER_CNT; i++)
+		list_init (&p->free[i]);
+	p->free_mask = 0;
+	p->free_cnt = 0;
+	memset (p->mags, 0, sizeof p->mags);
+	memset (p->order, ORDER_NONE, pgcnt);
+	lock_init (&p->zero_lock);
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
+	work_init (&p->zero_work, refill_zeroed);
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
@@ -356,3 +547,333 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to POOL's
+   free lists. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) {
+	list_push_front (&pool->free[order], &pool->links[page_idx]);
+	pool->order[page_idx] = order;
+	pool->free_mask |= 1u << order;
+}
+
+/* Removes the free block at PAGE_IDX from POOL's free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx) {
+	int order = pool->order[page_idx];
+
+	ASSERT (order != ORDER_NONE);
+	list_remove (&pool->links[page_idx]);
+	pool->order[page_idx] = ORDER_NONE;
+	if (list_empty (&pool->free[order]))
+		pool->free_mask &= ~(1u << order);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL, which must be
+   locked, and returns the index of the first, or BITMAP_ERROR if
+   there is no free block big enough.  A block of 2**N pages is
+   aligned to 2**N pages, where N is PAGE_CNT rounded up to a power
+   of 2. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) {
+	int order = page_cnt > 1 ? 64 - __builtin_clzll (page_cnt - 1) : 0;
+	uint32_t mask;
+	size_t page_idx;
+	int found;
+
+	ASSERT (page_cnt > 0);
+	if (order >= ORDER_CNT)
+		return BITMAP_ERROR;
+
+	/* Smallest nonempty order that is big enough. */
+	mask = pool->free_mask & ~((1u << order) - 1);
+	if (mask == 0)
+		return BITMAP_ERROR;
+	found = __builtin_ctz (mask);
+	page_idx = list_front (&pool->free[found]) - pool->links;
+	remove_block (pool, page_idx);
+
+	/* Split it down to ORDER, freeing the upper halves. */
+	while (found > order) {
+		found--;
+		push_block (pool, page_idx + ((size_t) 1 << found), found);
+	}
+
+	ASSERT (bitmap_none (pool->used_map, page_idx, (size_t) 1 << order));
+	bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, true);
+	pool->free_cnt -= (size_t) 1 << order;
+
+	/* Give back the pages past PAGE_CNT. */
+	if (page_cnt < (size_t) 1 << order)
+		buddy_free (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+	return page_idx;
+}
+
+/* Frees the PAGE_CNT allocated pages starting at index PAGE_IDX
+   in POOL, which must be locked or not yet in use, merging them
+   with free neighbors into blocks as large as possible. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t base_no = pg_no (pool->base);
+	size_t pool_cnt = bitmap_size (pool->used_map);
+	size_t end = page_idx + page_cnt;
+
+	ASSERT (end <= pool_cnt);
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool->free_cnt += page_cnt;
+
+	while (page_idx < end) {
+		/* Largest block that starts at PAGE_IDX, is aligned to its
+		   size, and fits in what is left. */
+		size_t page_no = base_no + page_idx;
+		int order = 0;
+
+		while (order + 1 < ORDER_CNT
+				&& page_no % ((size_t) 2 << order) == 0
+				&& page_idx + ((size_t) 2 << order) <= end)
+			order++;
+		page_idx += (size_t) 1 << order;
+
+		/* Merge with its buddy for as long as the buddy is a free
+		   block of the same order. */
+		while (order + 1 < ORDER_CNT) {
+			size_t buddy_no = page_no ^ ((size_t) 1 << order);
+			size_t buddy_idx = buddy_no - base_no;
+
+			if (buddy_no < base_no
+					|| buddy_idx + ((size_t) 1 << order) > pool_cnt
+					|| pool->order[buddy_idx] != order)
+				break;
+			remove_block (pool, buddy_idx);
+			page_no &= ~((size_t) 1 << order);
+			order++;
+		}
+		push_block (pool, page_no - base_no, order);
+	}
+}
+
+/* Returns a free page from the running CPU's magazine for POOL,
+   refilling the magazine from POOL if it is empty, or a null
+   pointer if POOL is out of pages. */
+static void *
+mag_alloc (struct pool *pool) {
+	void *batch[MAG_BATCH];
+	struct magazine *m;
+	void *page = NULL;
+	size_t batch_cnt, i;
+
+	thread_preempt_disable ();
+	m = &pool->mags[cpu_current ()->id];
+	mag_lock (m);
+	if (m->cnt > 0) {
+		page = m->pages[--m->cnt];
+		m->alloc_hits++;
+	} else
+		m->alloc_misses++;
+	mag_unlock (m);
+	thread_preempt_enable ();
+	if (page != NULL)
+		return page;
+
+	lock_acquire (&pool->lock);
+	batch_cnt = pool->free_cnt >= MAG_RESERVE ? MAG_BATCH : 1;
+	for (i = 0; i < batch_cnt; i++) {
+		size_t page_idx = buddy_alloc (pool, 1);
+		if (page_idx == BITMAP_ERROR)
+			break;
+		batch[i] = pool->base + PGSIZE * page_idx;
+	}
+	lock_release (&pool->lock);
+	if (i == 0)
+		return NULL;
+
+	/* Keep one page for the caller and put the rest in the
+	   magazine of whichever CPU we are on now.  Whatever does not
+	   fit goes back to the pool. */
+	page = batch[--i];
+	thread_preempt_disable ();
+	m = &pool->mags[cpu_current ()->id];
+	mag_lock (m);
+	while (i > 0 && m->cnt < MAG_SIZE)
+		m->pages[m->cnt++] = batch[--i];
+	mag_unlock (m);
+	thread_preempt_enable ();
+	if (i > 0) {
+		lock_acquire (&pool->lock);
+		while (i > 0)
+			buddy_free (pool, pg_no (batch[--i]) - pg_no (pool->base), 1);
+		lock_release (&pool->lock);
+	}
+	return page;
+}
+
+/* Puts PAGE, which was allocated from POOL, in the running CPU's
+   magazine for POOL, first draining MAG_BATCH pages from the
+   magazine to POOL if it is full. */
+static void
+mag_free (struct pool *pool, void *page) {
+	void *batch[MAG_BATCH];
+	struct magazine *m;
+	size_t batch_cnt = 0;
+
+	thread_preempt_disable ();
+	m = &pool->mags[cpu_current ()->id];
+	mag_lock (m);
+	if (m->cnt < MAG_SIZE)
+		m->free_hits++;
+	else {
+		while (batch_cnt < MAG_BATCH)
+			batch[batch_cnt++] = m->pages[--m->cnt];
+		m->free_misses++;
+	}
+	m->pages[m->cnt++] = page;
+	mag_unlock (m);
+	thread_preempt_enable ();
+
+	if (batch_cnt > 0) {
+		lock_acquire (&pool->lock);
+		while (batch_cnt > 0)
+			buddy_free (pool, pg_no (batch[--batch_cnt]) - pg_no (pool->base), 1);
+		lock_release (&pool->lock);
+	}
+}
+
+/* Marks magazine M as in use, waiting while another CPU uses it.
+   Magazines are never used in interrupt handlers, so unlike a
+   spinlock this does not need interrupts off, only preemption,
+   so that M is not held across a thread switch. */
+static void
+mag_lock (struct magazine *m) {
+	while (__atomic_exchange_n (&m->busy, 1, __ATOMIC_ACQUIRE))
+		while (m->busy)
+			asm volatile ("pause");
+}
+
+/* Ends a use of magazine M begun by mag_lock(). */
+static void
+mag_unlock (struct magazine *m) {
+	__atomic_store_n (&m->busy, 0, __ATOMIC_RELEASE);
+}
+
+/* Returns the pages in every CPU's magazine for POOL to POOL. */
+static void
+drain_magazines (struct pool *pool) {
+	int cpu;
+
+	for (cpu = 0; cpu < cpu_cnt; cpu++) {
+		struct magazine *m = &pool->mags[cpu];
+		void *batch[MAG_SIZE];
+		int batch_cnt;
+
+		thread_preempt_disable ();
+		mag_lock (m);
+		batch_cnt = m->cnt;
+		memcpy (batch, m->pages, sizeof *batch * batch_cnt);
+		m->cnt = 0;
+		mag_unlock (m);
+		thread_preempt_enable ();
+
+		if (batch_cnt > 0) {
+			lock_acquire (&pool->lock);
+			while (batch_cnt > 0)
+				buddy_free (pool, pg_no (batch[--batch_cnt]) - pg_no (pool->base), 1);
+			lock_release (&pool->lock);
+		}
+	}
+}
+
+/* Returns the pages in POOL's zeroed list to POOL. */
+static void
+drain_zeroed (struct pool *pool) {
+	struct list pages;
+
+	list_init (&pages);
+	lock_acquire (&pool->zero_lock);
+	while (!list_empty (&pool->zeroed))
+		list_push_back (&pages, list_pop_front (&pool->zeroed));
+	pool->zeroed_cnt = 0;
+	lock_release (&pool->zero_lock);
+
+	lock_acquire (&pool->lock);
+	while (!list_empty (&pages)) {
+		void *page = list_pop_front (&pages);
+		buddy_free (pool, pg_no (page) - pg_no (pool->base), 1);
+	}
+	lock_release (&pool->lock);
+}
+
+/* Returns PAGE_CNT contiguous free pages from POOL's buddy
+   allocator, or a null pointer if it has no block big enough. */
+static void *
+alloc_block (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+
+	lock_acquire (&pool->lock);
+	page_idx = buddy_alloc (pool, page_cnt);
+	lock_release (&pool->lock);
+	return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Takes a page from POOL's zeroed list, and has the list refilled
+   if it is running low.  Returns a null pointer if the list is
+   empty. */
+static void *
+take_zeroed (struct pool *pool) {
+	struct list_elem *page = NULL;
+	bool refill;
+
+	lock_acquire (&pool->zero_lock);
+	if (!list_empty (&pool->zeroed)) {
+		page = list_pop_front (&pool->zeroed);
+		pool->zeroed_cnt--;
+		pool->zeroed_hits++;
+	} else
+		pool->zeroed_misses++;
+	refill = pool->zeroed_cnt < ZEROED_LOW;
+	lock_release (&pool->zero_lock);
+
+	if (refill && zero_started)
+		queue_work (&zero_wq, &pool->zero_work);
+
+	if (page != NULL)
+		memset (page, 0, sizeof *page);
+	return page;
+}
+
+/* Zeroes free pages and adds them to the zeroed list of the pool
+   that contains WORK, until the list has ZEROED_HIGH pages or the
+   pool runs low.  Runs on zero_wq. */
+static void
+refill_zeroed (struct work *work) {
+	struct pool *pool = work_entry (work, struct pool, zero_work);
+
+	for (;;) {
+		size_t page_idx;
+		bool full;
+		void *page;
+
+		lock_acquire (&pool->zero_lock);
+		full = pool->zeroed_cnt >= ZEROED_HIGH;
+		lock_release (&pool->zero_lock);
+		if (full)
+			break;
+
+		lock_acquire (&pool->lock);
+		page_idx = BITMAP_ERROR;
+		if (pool->free_cnt >= MAG_RESERVE)
+			page_idx = buddy_alloc (pool, 1);
+		lock_release (&pool->lock);
+		if (page_idx == BITMAP_ERROR)
+			break;
+
+		page = pool->base + PGSIZE * page_idx;
+		memset (page, 0, PGSIZE);
+
+		lock_acquire (&pool->zero_lock);
+		list_push_back (&pool->zeroed, page);
+		pool->zeroed_cnt++;
+		lock_release (&pool->zero_lock);
+	}
+}
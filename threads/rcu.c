@@ -0,0 +1,144 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Grace periods.
+
+   Since a reader cannot be preempted and must not sleep, a CPU
+   that switches threads, or that takes a timer tick while its
+   thread is outside any read-side critical section, has finished
+   every read-side critical section it had started.  schedule()
+   and thread_tick() count these quiescent states in each CPU's
+   rcu_qs_cnt.  A grace period is over once every other CPU's
+   count has moved, or the CPU has gone idle.
+
+   Callbacks queued by call_rcu() are run in batches by the "rcu"
+   kernel thread, which waits out one grace period per batch. */
+
+/* Callbacks waiting for the rcu thread to pick them up. */
+static struct list pending = LIST_INITIALIZER (pending);
+
+/* Upped when PENDING becomes nonempty. */
+static struct semaphore pending_sema;
+
+static thread_func rcu_thread;
+
+/* Starts the thread that runs call_rcu() callbacks. */
+void
+rcu_init (void) {
+	sema_init (&pending_sema, list_empty (&pending) ? 0 : 1);
+	thread_create ("rcu", PRI_DEFAULT, rcu_thread, NULL);
+}
+
+/* Begins a read-side critical section.  These nest. */
+void
+rcu_read_lock (void) {
+	thread_preempt_disable ();
+}
+
+/* Ends a read-side critical section. */
+void
+rcu_read_unlock (void) {
+	thread_preempt_enable ();
+}
+
+/* Arranges for FUNC(HEAD) to be called, from the rcu thread,
+   once every read-side critical section that is running now has
+   ended.  May be called from an interrupt handler. */
+void
+call_rcu (struct rcu_head *head, void (*func) (struct rcu_head *)) {
+	enum intr_level old_level;
+
+	ASSERT (head != NULL);
+	ASSERT (func != NULL);
+
+	head->func = func;
+	old_level = intr_disable ();
+	if (list_empty (&pending))
+		sema_up (&pending_sema);
+	list_push_back (&pending, &head->elem);
+	intr_set_level (old_level);
+}
+
+/* Waits until every read-side critical section that is running
+   now has ended.  Sleeps, so it must not be called from an
+   interrupt handler or inside a read-side critical section. */
+void
+synchronize_rcu (void) {
+	uint64_t snap[CPU_MAX];
+	struct cpu *self = cpu_current ();
+	int i;
+
+	ASSERT (!intr_context ());
+
+	for (i = 0; i < cpu_cnt; i++)
+		snap[i] = __atomic_load_n (&cpus[i].rcu_qs_cnt, __ATOMIC_RELAXED);
+
+	/* The calling CPU need not be waited for: readers cannot be
+	   preempted, so none of its readers is in the middle of a
+	   read-side critical section while this thread runs. */
+	for (;;) {
+		bool done = true;
+
+		for (i = 0; i < cpu_cnt; i++) {
+			struct cpu *cpu = &cpus[i];
+
+			if (cpu != self
+					&& __atomic_load_n (&cpu->rcu_qs_cnt, __ATOMIC_RELAXED) == snap[i]
+					&& __atomic_load_n (&cpu->curr, __ATOMIC_RELAXED) != cpu->idle_thread)
+				done = false;
+		}
+		if (done)
+			break;
+
+		/* This may wake up on another CPU, but that is no problem:
+		   each CPU is checked against its own snapshot. */
+		timer_sleep (1);
+		self = cpu_current ();
+	}
+}
+
+/* Inserts ELEM at the beginning of LIST, which readers may be
+   walking forward under rcu_read_lock().  ELEM is linked in
+   before it is published, so readers see either the old list or
+   the new one.  Writers must exclude each other.  (list_remove()
+   is safe as is, since it leaves the removed element's `next'
+   pointing back into the list.) */
+void
+rcu_list_push_front (struct list *list, struct list_elem *elem) {
+	struct list_elem *first = list_begin (list);
+
+	elem->prev = first->prev;
+	elem->next = first;
+	rcu_assign_pointer (first->prev->next, elem);
+	first->prev = elem;
+}
+
+/* Runs call_rcu() callbacks a batch at a time. */
+static void
+rcu_thread (void *aux UNUSED) {
+	for (;;) {
+		struct list batch;
+		enum intr_level old_level;
+
+		sema_down (&pending_sema);
+
+		list_init (&batch);
+		old_level = intr_disable ();
+		while (!list_empty (&pending))
+			list_push_back (&batch, list_pop_front (&pending));
+		intr_set_level (old_level);
+
+		synchronize_rcu ();
+
+		while (!list_empty (&batch)) {
+			struct rcu_head *head = list_entry (list_pop_front (&batch),
+					struct rcu_head, elem);
+			head->func (head);
+		}
+	}
+}
@@ -29,8 +29,31 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Maximum number of times an adaptive lock polls its holder
+   before giving up and blocking. */
+#define LOCK_SPIN_MAX 1000
+
+/* Maximum length of a chain of nested priority donations. */
+#define DONATE_DEPTH_MAX 8
+
+/* All adaptive locks, for lock_print_stats(). */
+static struct list adaptive_locks = LIST_INITIALIZER (adaptive_locks);
+
+static bool lock_spin (struct lock *);
+static void donate_chain (struct thread *, int depth);
+static int rwlock_donated_priority (struct thread *, int priority);
+static void rwlock_add_holder (struct rwlock_hold *);
+static void rwlock_remove_holder (struct rwlock_hold *);
+static int rwlock_wake (struct rwlock *);
+static void rwlock_wait (struct rwlock_hold *, struct heap *);
+static void rwlock_released (struct rwlock_hold *);
+static heap_less_func waiter_less;
+static heap_less_func cond_waiter_less;
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +69,15 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	heap_init (&sema->waiters, waiter_less, NULL);
+}
+
+/* Orders semaphore waiters highest priority first. */
+static bool
+waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, wait_elem)->priority
+		> heap_entry (b, struct thread, wait_elem)->priority;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -67,8 +98,10 @@ sema_down (struct semaphore *sema) {
 	old_level = intr_disable ();
 
 	while (sema->value == 0) {
-		// list_push_back (&sema->waiters, &thread_current ()->elem);
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, compare_thread_priority, NULL); // compare 로직 변경
+		struct thread *cur = thread_current ();
+
+		cur->blocked_heap = &sema->waiters;
+		heap_push (&sema->waiters, &cur->wait_elem);
 		thread_block ();
 	}
 	sema->value--;
@@ -114,14 +147,19 @@ sema_up (struct semaphore *sema) {
 
 	sema->value++;
 
-	if (!list_empty (&sema->waiters))
+	if (!heap_empty (&sema->waiters))
 	{
-		list_sort(&sema->waiters, compare_thread_priority, NULL);
-		struct thread *temp_thread = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
+		struct thread *temp_thread = heap_entry (heap_pop_min (&sema->waiters), struct thread, wait_elem);
+		temp_thread->blocked_heap = NULL;
 		thread_unblock (temp_thread);
 
-		if(temp_thread->priority > thread_current()->priority)
-			thread_yield();
+		if(thread_runs_before(temp_thread, thread_current()))
+		{
+			if (intr_context ())
+				intr_yield_on_return ();
+			else
+				thread_yield();
+		}
 	}
 
 	intr_set_level (old_level);
@@ -183,6 +221,31 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	lock->name = NULL;
+	lock->acquire_cnt = 0;
+	lock->contend_cnt = 0;
+	lock->wait_cycles = 0;
+}
+
+/* Initializes LOCK as an adaptive lock named NAME, for short
+   critical sections.  A thread that finds an adaptive lock held
+   by a thread running on another CPU busy-waits for a while
+   before it blocks, on the theory that the lock will be released
+   sooner than a context switch would take.  Adaptive locks are
+   otherwise the same as other locks, and their statistics are
+   printed by lock_print_stats(). */
+void
+lock_init_adaptive (struct lock *lock, const char *name) {
+	enum intr_level old_level;
+
+	ASSERT (name != NULL);
+
+	lock_init (lock);
+	lock->name = name;
+
+	old_level = intr_disable ();
+	list_push_back (&adaptive_locks, &lock->elem);
+	intr_set_level (old_level);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -195,10 +258,27 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	uint64_t start;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	if (sema_try_down (&lock->semaphore)) {
+		lock->holder = thread_current ();
+		lock->acquire_cnt++;
+		return;
+	}
+
+	start = rdtsc ();
+	if (lock->name != NULL && lock_spin (lock)) {
+		lock->holder = thread_current ();
+		lock->acquire_cnt++;
+		lock->contend_cnt++;
+		lock->wait_cycles += rdtsc () - start;
+		return;
+	}
+
 	// if(lock->holder != NULL)
 	// {
 	// 	thread_current()->wait_on_lock = lock;
@@ -212,20 +292,55 @@ lock_acquire (struct lock *lock) {
 
 	if(!thread_mlfqs)
 	{
+		/* With interrupts off, the holder cannot release LOCK on
+		   another CPU, and walk or leave its donation list, while
+		   we link ourselves into it. */
+		enum intr_level old_level = intr_disable ();
+		struct thread *holder = lock->holder;
 
-		if (lock->holder) {
+		if (holder != NULL) {
 			// Todo 1
 			cur->wait_on_lock = lock;
 			// Todo 2
-			list_insert_ordered(&(lock->holder->donation_list), &(cur->donation_elem), cmp_lock_priority, NULL);
+			list_insert_ordered(&(holder->donation_list), &(cur->donation_elem), cmp_lock_priority, NULL);
 			// Todo 3
 			donate_priority();
 		}
+		intr_set_level (old_level);
 	}
 
 	sema_down (&lock->semaphore);
 
 	lock->holder = cur;
+	lock->acquire_cnt++;
+	lock->contend_cnt++;
+	lock->wait_cycles += rdtsc () - start;
+}
+
+/* Busy-waits for adaptive LOCK as long as its holder is running
+   on another CPU, up to LOCK_SPIN_MAX polls.  Returns true if
+   LOCK was acquired, false if the caller should block instead.
+   Spinning is pointless with one CPU, since the holder cannot be
+   running, and with interrupts off, since the holder would then
+   be unable to take the interrupt lock to release LOCK. */
+static bool
+lock_spin (struct lock *lock) {
+	int i;
+
+	if (cpu_cnt <= 1 || intr_get_level () == INTR_OFF)
+		return false;
+
+	for (i = 0; i < LOCK_SPIN_MAX; i++) {
+		struct thread *holder = lock->holder;
+
+		if (holder == NULL) {
+			if (sema_try_down (&lock->semaphore))
+				return true;
+		} else if (holder->status != THREAD_RUNNING)
+			return false;
+		asm volatile ("pause" : : : "memory");
+	}
+	return false;
 }
 
 bool cmp_lock_priority(struct list_elem *cur, struct list_elem *cmp, void *aux UNUSED) {
@@ -235,13 +350,40 @@ bool cmp_lock_priority(struct list_elem *cur, struct list_elem *cmp, void *aux U
 }
 
 void donate_priority (void) {
-	struct thread *cur = thread_current ();
+	donate_chain (thread_current (), 0);
+}
+
+/* Donates the priority of T, which is about to wait or is
+   waiting for a lock or RW lock, to the lock's holder or the RW
+   lock's holders, and on down the chain of whatever those are
+   waiting for in turn. */
+static void
+donate_chain (struct thread *t, int depth) {
+	struct list_elem *e;
+
+	if (depth >= DONATE_DEPTH_MAX)
+		return;
+
+	if (t->wait_on_lock != NULL) {
+		struct thread *holder = t->wait_on_lock->holder;
 
-	while (cur->wait_on_lock != NULL){
-		struct thread *holder = cur->wait_on_lock->holder;
-		if (cur->priority > holder->priority)
-			holder->priority = cur->priority;
-		cur = holder;
+		if (holder != NULL) {
+			if (t->priority > holder->priority)
+				thread_update_priority (holder, t->priority);
+			donate_chain (holder, depth + 1);
+		}
+	} else if (t->wait_on_rwlock != NULL) {
+		struct list *holders = &t->wait_on_rwlock->rwlock->holders;
+
+		for (e = list_begin (holders); e != list_end (holders);
+				e = list_next (e)) {
+			struct thread *holder = list_entry (e, struct rwlock_hold, elem)->thread;
+
+			if (t->priority > holder->priority) {
+				thread_update_priority (holder, t->priority);
+				donate_chain (holder, depth + 1);
+			}
+		}
 	}
 }
 
@@ -286,8 +428,10 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		lock->acquire_cnt++;
+	}
 	return success;
 }
 
@@ -299,9 +443,15 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
+	/* Pairs with the donation in lock_acquire(): a waiter that
+	   reads LOCK's holder after this sees null. */
+	old_level = intr_disable ();
+
 	// remove_donation_list(lock);
 	// change_donation_priority();
 	//----------------------------------------------------------------------------------
@@ -323,10 +473,12 @@ lock_release (struct lock *lock) {
 			}
 		}
 
-		lock->holder->priority = max_priority;
+		thread_update_priority (lock->holder,
+				rwlock_donated_priority (lock->holder, max_priority));
 	}
 
 	lock->holder = NULL;
+	intr_set_level (old_level);
 	sema_up (&lock->semaphore);
 }
 
@@ -361,6 +513,21 @@ lock_release (struct lock *lock) {
 // 	curr->priority = change_priority;
 // }
 
+/* Prints statistics for every adaptive lock. */
+void
+lock_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&adaptive_locks); e != list_end (&adaptive_locks);
+			e = list_next (e)) {
+		struct lock *lock = list_entry (e, struct lock, elem);
+
+		printf ("Lock %s: %llu acquired, %llu contended, %llu cycles waiting\n",
+				lock->name, lock->acquire_cnt, lock->contend_cnt,
+				lock->wait_cycles);
+	}
+}
+
 /* Returns true if the current thread holds LOCK, false
    otherwise.  (Note that testing whether some other thread holds
    a lock would be racy.) */
@@ -371,9 +538,10 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition variable's waiters. */
 struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
+	struct heap_elem elem;              /* Heap element. */
+	struct thread *thread;              /* Thread waiting on SEMAPHORE. */
 	struct semaphore semaphore;         /* This semaphore. */
 };
 
@@ -384,7 +552,15 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	heap_init (&cond->waiters, cond_waiter_less, NULL);
+}
+
+/* Orders condition variable waiters highest priority first. */
+static bool
+cond_waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct semaphore_elem, elem)->thread->priority
+		> heap_entry (b, struct semaphore_elem, elem)->thread->priority;
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -410,6 +586,8 @@ cond_init (struct condition *cond) {
 void
 cond_wait (struct condition *cond, struct lock *lock) {
 	struct semaphore_elem waiter;
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -417,29 +595,23 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
+	waiter.thread = cur;
 
-	struct thread *cur_sema = list_entry(list_begin(&waiter.semaphore.waiters), struct thread, elem);
-	cur_sema->priority = lock->holder->priority;
-	// list_push_back (&cond->waiters, &waiter.elem);
+	/* Priority donation can re-key WAITER from another thread at
+	   any time, and so can lock_release() below when it ends a
+	   donation to us, so the heap is only touched with interrupts
+	   off, and only through thread_update_priority(). */
+	old_level = intr_disable ();
+	cur->blocked_cond = cond;
+	cur->cond_elem = &waiter.elem;
+	heap_push (&cond->waiters, &waiter.elem);
+	intr_set_level (old_level);
 
-	list_insert_ordered(&cond->waiters, &waiter.elem, compare_sema_priority, NULL);
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
 	lock_acquire (lock);
 }
 
-bool
-compare_sema_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED)
-{
-	struct semaphore_elem *sema_elem_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_elem_b = list_entry(b, struct semaphore_elem, elem);
-
-	struct thread *thread_a = list_entry(list_begin(&sema_elem_a->semaphore.waiters), struct thread, elem);
-	struct thread *thread_b = list_entry(list_begin(&sema_elem_b->semaphore.waiters), struct thread, elem);
-
-	return thread_a->priority > thread_b->priority;
-}
-
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -454,12 +626,17 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters))
+	enum intr_level old_level = intr_disable ();
+
+	if (!heap_empty (&cond->waiters))
 	{
-		list_sort(&cond->waiters, compare_sema_priority, NULL);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+		struct semaphore_elem *waiter = heap_entry (heap_pop_min (&cond->waiters),
+				struct semaphore_elem, elem);
+
+		waiter->thread->blocked_cond = NULL;
+		sema_up (&waiter->semaphore);
 	}
+	intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -473,6 +650,299 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!heap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK as free. */
+void
+rwlock_init (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	rwlock->readers = 0;
+	rwlock->writer = NULL;
+	list_init (&rwlock->holders);
+	heap_init (&rwlock->read_waiters, waiter_less, NULL);
+	heap_init (&rwlock->write_waiters, waiter_less, NULL);
+}
+
+/* Acquires RWLOCK for reading, sleeping while it is held for
+   writing or a writer is waiting for it, and records the hold in
+   HOLD, which must stay in place until the matching
+   rwlock_release_read().  The current thread must not already
+   hold RWLOCK.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock, struct rwlock_hold *hold) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (hold != NULL);
+	ASSERT (!intr_context ());
+
+	hold->rwlock = rwlock;
+	hold->thread = thread_current ();
+
+	old_level = intr_disable ();
+	if (rwlock->writer == NULL && heap_empty (&rwlock->write_waiters)) {
+		rwlock->readers++;
+		rwlock_add_holder (hold);
+	} else
+		rwlock_wait (hold, &rwlock->read_waiters);
+	intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading through HOLD. */
+void
+rwlock_release_read (struct rwlock *rwlock, struct rwlock_hold *hold) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rwlock->readers > 0);
+	ASSERT (hold->rwlock == rwlock && hold->thread == thread_current ());
+
+	old_level = intr_disable ();
+	rwlock->readers--;
+	rwlock_released (hold);
+	intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing, sleeping while anyone else holds
+   it, and records the hold in HOLD, which must stay in place
+   until the matching rwlock_release_write().  The current thread
+   must not already hold RWLOCK.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock, struct rwlock_hold *hold) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (hold != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rwlock->writer != thread_current ());
+
+	hold->rwlock = rwlock;
+	hold->thread = thread_current ();
+
+	old_level = intr_disable ();
+	if (rwlock->writer == NULL && rwlock->readers == 0) {
+		rwlock->writer = thread_current ();
+		rwlock_add_holder (hold);
+	} else
+		rwlock_wait (hold, &rwlock->write_waiters);
+	intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing through HOLD. */
+void
+rwlock_release_write (struct rwlock *rwlock, struct rwlock_hold *hold) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rwlock->writer == thread_current ());
+	ASSERT (hold->rwlock == rwlock && hold->thread == thread_current ());
+
+	old_level = intr_disable ();
+	rwlock->writer = NULL;
+	rwlock_released (hold);
+	intr_set_level (old_level);
+}
+
+/* Blocks the current thread in WAITERS, one of the waiter heaps
+   of HOLD's RW lock, after donating its priority to the lock's
+   holders.  The thread that wakes it up has already made it a
+   holder through HOLD. */
+static void
+rwlock_wait (struct rwlock_hold *hold, struct heap *waiters) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	cur->wait_on_rwlock = hold;
+	cur->blocked_heap = waiters;
+	heap_push (waiters, &cur->wait_elem);
+	if (!thread_mlfqs)
+		donate_chain (cur, 0);
+	thread_block ();
+}
+
+/* Finishes the current thread's release of the RW lock that it
+   holds through HOLD: drops the hold, hands the lock on if it is
+   now free, and gives up the priority that the lock's waiters
+   donated.  Yields if a thread that was woken up should run
+   instead. */
+static void
+rwlock_released (struct rwlock_hold *hold) {
+	struct rwlock *rwlock = hold->rwlock;
+	struct thread *cur = thread_current ();
+	int woken = PRI_MIN - 1;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	rwlock_remove_holder (hold);
+	if (rwlock->writer == NULL && rwlock->readers == 0)
+		woken = rwlock_wake (rwlock);
+
+	if (!thread_mlfqs) {
+		struct list_elem *e;
+		int priority = cur->origin_priority;
+
+		for (e = list_begin (&cur->donation_list);
+				e != list_end (&cur->donation_list); e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, donation_elem);
+			if (t->priority > priority)
+				priority = t->priority;
+		}
+		thread_update_priority (cur, rwlock_donated_priority (cur, priority));
+	}
+
+	if (woken > cur->priority)
+		thread_yield ();
+}
+
+/* Hands RWLOCK, which must be free, to the highest-priority
+   waiting writer if there is one, or else to all waiting readers.
+   Returns the highest priority among the threads woken up, or
+   PRI_MIN - 1 if none were. */
+static int
+rwlock_wake (struct rwlock *rwlock) {
+	struct heap *waiters;
+	int woken = PRI_MIN - 1;
+
+	waiters = !heap_empty (&rwlock->write_waiters)
+		? &rwlock->write_waiters : &rwlock->read_waiters;
+	while (!heap_empty (waiters)) {
+		struct thread *t = heap_entry (heap_pop_min (waiters),
+				struct thread, wait_elem);
+
+		if (waiters == &rwlock->write_waiters)
+			rwlock->writer = t;
+		else
+			rwlock->readers++;
+		rwlock_add_holder (t->wait_on_rwlock);
+		t->wait_on_rwlock = NULL;
+		t->blocked_heap = NULL;
+		thread_unblock (t);
+		if (t->priority > woken)
+			woken = t->priority;
+
+		if (rwlock->writer != NULL)
+			break;
+	}
+	return woken;
+}
+
+/* Returns the greater of PRIORITY and the priority of the
+   highest-priority thread waiting for an RW lock that T holds. */
+static int
+rwlock_donated_priority (struct thread *t, int priority) {
+	struct list_elem *e;
+
+	for (e = list_begin (&t->rw_holds); e != list_end (&t->rw_holds);
+			e = list_next (e)) {
+		struct rwlock *rwlock = list_entry (e, struct rwlock_hold,
+				thread_elem)->rwlock;
+		struct heap *waiters[2];
+		int j;
+
+		waiters[0] = &rwlock->read_waiters;
+		waiters[1] = &rwlock->write_waiters;
+		for (j = 0; j < 2; j++)
+			if (!heap_empty (waiters[j])) {
+				struct thread *w = heap_entry (heap_min (waiters[j]),
+						struct thread, wait_elem);
+				if (w->priority > priority)
+					priority = w->priority;
+			}
+	}
+	return priority;
+}
+
+/* Records that HOLD's thread holds HOLD's RW lock. */
+static void
+rwlock_add_holder (struct rwlock_hold *hold) {
+	list_push_back (&hold->rwlock->holders, &hold->elem);
+	list_push_back (&hold->thread->rw_holds, &hold->thread_elem);
+}
+
+/* Records that HOLD's thread no longer holds HOLD's RW lock. */
+static void
+rwlock_remove_holder (struct rwlock_hold *hold) {
+	list_remove (&hold->elem);
+	list_remove (&hold->thread_elem);
+}
+
+/* Changes the priority of T to PRIORITY, and moves T to its new
+   place among the waiters of the semaphore, condition variable,
+   or RW lock that it is waiting on.  T need not be blocked yet:
+   cond_wait() queues the running thread before it releases the
+   lock, which may lower its priority.  Called with interrupts off
+   by thread_update_priority(). */
+void
+synch_update_priority (struct thread *t, int priority) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->blocked_heap != NULL)
+		heap_remove (t->blocked_heap, &t->wait_elem);
+	if (t->blocked_cond != NULL)
+		heap_remove (&t->blocked_cond->waiters, t->cond_elem);
+
+	t->priority = priority;
+
+	if (t->blocked_heap != NULL)
+		heap_push (t->blocked_heap, &t->wait_elem);
+	if (t->blocked_cond != NULL)
+		heap_push (&t->blocked_cond->waiters, t->cond_elem);
+}
+
+/* Initializes LOCK as free. */
+void
+spin_init (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+	lock->cpu = NULL;
+}
+
+/* Acquires LOCK for the calling CPU, spinning until it is free.
+   Interrupts must be off, so that the holder is not preempted
+   while other CPUs wait for it, and the calling CPU must not
+   already hold LOCK. */
+void
+spin_lock (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!spin_held (lock));
+
+	/* The exchange is a full barrier, so nothing done under the
+	   lock can move ahead of taking it.  Spin on plain reads to
+	   keep the cache line shared while the lock is busy. */
+	while (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE))
+		while (lock->locked)
+			asm volatile ("pause");
+	lock->cpu = cpu_current ();
+}
+
+/* Releases LOCK, which the calling CPU must hold. */
+void
+spin_unlock (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (spin_held (lock));
+
+	lock->cpu = NULL;
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Returns true if the calling CPU holds LOCK, false otherwise. */
+bool
+spin_held (const struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock->locked && lock->cpu == cpu_current ();
+}
@@ -2,14 +2,23 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,33 +33,135 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO list
+   per priority level, and bit N of MASK is set whenever
+   LISTS[N] is non-empty, so the highest-priority ready thread is
+   found with a single bit scan instead of a sorted insert.
+   Threads in the deadline class wait in DL instead, earliest
+   deadline first, and run ahead of all of the lists.  With
+   -cfs, the other threads wait in FAIR rather than in the lists.
+   Each CPU schedules from its own ready queue. */
+struct ready_queue {
+	struct heap dl;                     /* Deadline threads. */
+	struct heap fair;                   /* Threads by vruntime (-cfs). */
+	int64_t min_vruntime;               /* Least vruntime on CPU (-cfs). */
+	struct list lists[PRI_MAX + 1];     /* One list per priority. */
+	uint64_t mask;                      /* Non-empty priority levels. */
+	size_t cnt;                         /* # of threads in all queues. */
+};
+static struct ready_queue ready_queues[CPU_MAX];
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
 /* Thread destruction requests */
 static struct list destruction_req;
 
-static struct list sleep_list;
+/* Frees the blocks of the threads in destruction_req, on
+   reaper_wq's single PRI_MIN thread, so that a burst of exits is
+   cleaned up when there is nothing better to do rather than on
+   the way into the scheduler.  thread_alloc() takes blocks
+   straight from destruction_req meanwhile, so threads that exit
+   and are replaced faster than the reaper runs cost nothing. */
+static struct workqueue reaper_wq;
+static struct work reap_work;
+
+/* Blocks of threads that have exited, kept for reuse by
+   thread_create() with their guard pages still unmapped, so that
+   creating a thread does not usually have to allocate pages,
+   zero them, or change the page table.  Only the struct thread
+   is cleared on reuse; nothing reads the old stack. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+
+/* Sleeping threads ordered by awake_tick, and the earliest
+   awake_tick among them (INT64_MAX if none), so that the timer
+   interrupt only touches the queue when a thread is due. */
+static struct heap sleep_queue;
+static int64_t next_awake_tick;
 static struct list all_list;
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* Statistics, in TSC cycles. */
+static long long idle_cycles;   /* # of cycles spent idle. */
+static long long kernel_cycles; /* # of cycles in kernel threads. */
+static long long user_cycles;   /* # of cycles in user programs. */
+
+/* Histogram of the TSC cycles that schedule() takes to pick the
+   next thread and get ready to switch to it.  Bucket N counts
+   switches that took at least 2**N cycles (bucket 0 also counts
+   faster ones) and less than 2**(N+1); the last bucket also
+   counts anything slower. */
+#define SWITCH_HIST_BUCKETS 24
+static long long switch_hist[SWITCH_HIST_BUCKETS];
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+#define BALANCE_INTERVAL 8      /* # of timer ticks between rebalances. */
+
+/* Deadline class.
+
+   A thread in the deadline class asks for RUNTIME ns of CPU time
+   in every PERIOD, each within DEADLINE of the period's start.
+   Deadline threads run ahead of every other thread, earliest
+   absolute deadline first (EDF), on the CPU they were admitted
+   to.  On one CPU, EDF meets every deadline as long as the sum of
+   RUNTIME / DEADLINE over its threads is at most 1, so admission
+   control keeps that sum at most DL_DENSITY_MAX on each CPU,
+   leaving the rest for the priority scheduler.
+
+   A thread's budget is charged as it runs.  Once it is used up,
+   the thread sleeps until its next period, so that a thread that
+   overruns cannot make the others miss their deadlines.  When a
+   thread wakes up, it keeps its deadline and what is left of its
+   budget only if running for that long before the deadline would
+   not exceed its density; otherwise it gets a fresh budget and
+   deadline, as in a constant bandwidth server. */
+#define DL_SHIFT 20             /* Fraction bits of dl_density. */
+#define DL_DENSITY_MAX ((95 << DL_SHIFT) / 100)
+#define DL_PERIOD_MAX (10LL * 1000 * 1000 * 1000)
+
+/* Sum of dl_density over the threads admitted to each CPU. */
+static uint64_t dl_load[CPU_MAX];
+
+/* Fair scheduler.
+
+   Each thread outside the deadline class accumulates a virtual
+   run time: the nanoseconds it has run, scaled by NICE_0_WEIGHT
+   over the weight for its nice value, so that a thread with a
+   lower nice value ages more slowly and gets a larger share of
+   the CPU.  Each CPU runs the ready thread with the least
+   vruntime, for CFS_LATENCY divided by the number of threads
+   competing for the CPU but at least CFS_MIN_GRANULARITY, so
+   that every thread gets a turn about once per CFS_LATENCY.
+
+   A ready queue's min_vruntime follows the least vruntime on its
+   CPU, but only moves forward.  A thread that wakes up starts at
+   most CFS_LATENCY / 2 behind it, so that sleeping does not bank
+   CPU time, and a thread that moves to another CPU keeps its
+   distance from min_vruntime. */
+bool thread_cfs;
+
+#define CFS_LATENCY (2 * TIME_SLICE * TIMER_NS_PER_TICK)
+#define CFS_MIN_GRANULARITY TIMER_NS_PER_TICK
+#define CFS_WAKEUP_GRANULARITY (TIMER_NS_PER_TICK / 2)
+
+/* Weight of each nice value from NICE_MIN to NICE_MAX.  Each step
+   is about 1.25 times the next, so one nice level is about 10%
+   of the CPU between two otherwise equal threads. */
+#define NICE_0_WEIGHT 1024
+static const int nice_weights[] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548, 7620, 6100, 4904, 3906,
+	/*  -5 */ 3121, 2501, 1991, 1586, 1277,
+	/*   0 */ 1024, 820, 655, 526, 423,
+	/*   5 */ 335, 272, 215, 172, 137,
+	/*  10 */ 110, 87, 70, 56, 45,
+	/*  15 */ 36, 29, 23, 18, 15,
+	/*  20 */ 12,
+};
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -58,29 +169,87 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 #define FRACTIONAL  			(1 << 14)
 #define RECENT_CPU_DEFAULT		0
 #define LOAD_AVG_DEFAULT		0
-#define NICE_DEFAULT			0
 
 static int load_avg;
 bool thread_mlfqs;
 
+/* The once-a-second recent_cpu decay is applied right away only to
+   threads that are running or ready, whose priorities matter now.
+   A blocked thread catches up on the decays it missed when it is
+   unblocked, using the load averages kept here: decay number N
+   used LOAD_AVG_HISTORY[N % DECAY_HISTORY].  A thread blocked for
+   longer than DECAY_HISTORY seconds only gets the last
+   DECAY_HISTORY decays, by which time its recent_cpu has long
+   converged anyway. */
+#define DECAY_HISTORY 64
+static int load_avg_history[DECAY_HISTORY];
+static int64_t decay_epoch;     /* # of decays so far. */
+
+/* Threads whose recent_cpu changed since their priority was last
+   computed, so that the every-4-ticks priority update does not
+   have to visit every thread. */
+static struct list recent_cpu_changed;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void ready_queue_init (struct ready_queue *);
+static void ready_queue_push (struct ready_queue *, struct thread *);
+static void ready_queue_remove (struct ready_queue *, struct thread *);
+static struct thread *ready_queue_pop (struct ready_queue *);
+static struct thread *ready_queue_first (struct ready_queue *);
+static int ready_queue_max_priority (const struct ready_queue *);
+static struct thread *ready_queue_first_movable (struct ready_queue *);
+static heap_less_func dl_deadline_less;
+static heap_less_func vruntime_less;
+static struct ready_queue *cpu_ready_queue (const struct cpu *);
+static bool cpu_is_idle (const struct cpu *);
+static struct cpu *select_cpu (struct thread *);
+static int cpu_load (const struct cpu *);
+static struct thread *steal_thread (struct cpu *, int load);
+static void rebalance (struct cpu *);
+static void charge_cycles (struct cpu *);
+static void dl_charge (struct thread *);
+static void dl_wakeup (struct thread *);
+static void dl_throttle (struct thread *);
+static void dl_leave (struct thread *);
+static void cfs_charge (struct thread *);
+static void cfs_place (struct thread *, struct cpu *);
+static int64_t cfs_slice (struct cpu *);
+static void recent_cpu_catch_up (struct thread *);
+static void recent_cpu_mark_changed (struct thread *);
+static int mlfqs_priority (struct thread *);
+static void ready_queue_decay (struct ready_queue *);
+static void print_switch_hist (void);
+static void reap_threads (struct work *);
+static struct thread *thread_alloc (void);
+static void thread_free (struct thread *);
 static void do_schedule(int status);
 static void schedule (void);
+static void record_switch (uint64_t cycles);
 static tid_t allocate_tid (void);
+static bool awake_tick_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
 
 /* Returns the running thread.
  * Read the CPU's stack pointer `rsp', and then round that
- * down to the start of a page.  Since `struct thread' is
- * always at the beginning of a page and the stack pointer is
+ * down to the start of a thread block.  Since `struct thread' is
+ * always at the beginning of its block and the stack pointer is
  * somewhere in the middle, this locates the curent thread. */
-#define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
+#define running_thread() thread_from_sp (rrsp ())
+
+/* The initial thread's block is the boot stack at
+   LOADER_KERN_BASE, which running_thread() must find too. */
+_Static_assert ((THREAD_STACK_PAGES & (THREAD_STACK_PAGES - 1)) == 0,
+		"THREAD_STACK_PAGES must be a power of two");
+_Static_assert (LOADER_KERN_BASE % THREAD_STACK_SIZE == 0,
+		"the boot stack must be aligned like a thread block");
 
 
 // Global descriptor table for the thread_start.
@@ -93,7 +262,7 @@ static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -103,6 +272,8 @@ static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
    finishes. */
 void
 thread_init (void) {
+	int i;
+
 	ASSERT (intr_get_level () == INTR_OFF);
 
 	/* Reload the temporal gdt for the kernel
@@ -116,16 +287,28 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
+	for (i = 0; i < CPU_MAX; i++)
+		ready_queue_init (&ready_queues[i]);
 	// 삭제할 스레드 리스트
 	list_init (&destruction_req);
-	list_init(&sleep_list);
+	work_init (&reap_work, reap_threads);
+	list_init (&thread_cache);
+	heap_init(&sleep_queue, awake_tick_less, NULL);
+	next_awake_tick = INT64_MAX;
 	list_init(&all_list);
+	list_init(&recent_cpu_changed);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
+
+	/* We are running on the boot CPU. */
+	initial_thread->cpu = &cpus[0];
+	cpus[0].curr = initial_thread;
+	cpus[0].switch_tsc = rdtsc ();
+	cpus[0].started = true;
+	cpu_cnt = 1;
+
 	list_push_back(&all_list, &initial_thread->all_elem);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
@@ -148,6 +331,55 @@ thread_start (void) {
 
 	/* Wait for the idle thread to initialize idle_thread. */
 	sema_down (&idle_started);
+
+	/* No thread can have exited yet. */
+	workqueue_create_idle (&reaper_wq, "reaper");
+}
+
+/* Allocates and returns the idle thread of CPU, which is about to
+   be started, or a null pointer if memory is short.  Runs on the
+   boot CPU, since allocating may block; the new CPU then starts
+   on the thread's stack and calls thread_init_ap(). */
+struct thread *
+thread_prepare_ap (struct cpu *cpu) {
+	struct thread *t = thread_alloc ();
+	char name[sizeof t->name];
+
+	if (t == NULL)
+		return NULL;
+	snprintf (name, sizeof name, "idle%d", cpu->id);
+	init_thread (t, name, PRI_MIN);
+	t->tid = allocate_tid ();
+	t->cpu = cpu;
+	cpu->idle_thread = t;
+	cpu->curr = t;
+	return t;
+}
+
+/* Turns the code running on an application processor, on the
+   stack set up by thread_prepare_ap(), into its idle thread.
+   Like thread_init(), also loads the temporal gdt. */
+void
+thread_init_ap (void) {
+	struct thread *t = running_thread ();
+	struct desc_ptr gdt_ds = {
+		.size = sizeof (gdt) - 1,
+		.address = (uint64_t) gdt
+	};
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (is_thread (t) && t == t->cpu->idle_thread);
+
+	lgdt (&gdt_ds);
+	t->status = THREAD_RUNNING;
+	t->cpu->switch_tsc = rdtsc ();
+}
+
+/* Starts scheduling on an application processor by running its
+   idle thread. */
+void
+thread_start_ap (void) {
+	idle_loop ();
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -155,27 +387,90 @@ thread_start (void) {
 void
 thread_tick (void) {
 	struct thread *t = thread_current ();
+	struct cpu *cpu = t->cpu;
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
-#ifdef USERPROG
-	else if (t->pml4 != NULL)
-		user_ticks++;
-#endif
-	else
-		kernel_ticks++;
-
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	charge_cycles (cpu);
+
+	/* The interrupted thread is not reading anything protected by
+	   RCU, unless it has preemption disabled. */
+	if (t->preempt_cnt == 0)
+		cpu->rcu_qs_cnt++;
+
+	/* Enforce preemption.  A deadline thread is not time sliced,
+	   but is throttled once its budget runs out. */
+	if (t->dl) {
+		dl_charge (t);
+		if (t->dl_budget <= 0)
+			intr_yield_on_return ();
+	} else if (thread_cfs) {
+		if (t != cpu->idle_thread)
+			cfs_charge (t);
+		if (++cpu->thread_ticks * TIMER_NS_PER_TICK >= cfs_slice (cpu))
+			intr_yield_on_return ();
+	} else if (++cpu->thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
+
+	/* Even out the load between CPUs. */
+	if (++cpu->balance_ticks >= BALANCE_INTERVAL) {
+		cpu->balance_ticks = 0;
+		rebalance (cpu);
+	}
 }
 
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
-	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-			idle_ticks, kernel_ticks, user_ticks);
+	enum intr_level old_level = intr_disable ();
+
+	charge_cycles (cpu_current ());
+	intr_set_level (old_level);
+	printf ("Thread: %lld idle cycles, %lld kernel cycles, %lld user cycles\n",
+			idle_cycles, kernel_cycles, user_cycles);
+	print_switch_hist ();
+}
+
+/* Prints the nonempty buckets of switch_hist. */
+static void
+print_switch_hist (void) {
+	long long hist[SWITCH_HIST_BUCKETS];
+	enum intr_level old_level;
+	int i;
+
+	old_level = intr_disable ();
+	memcpy (hist, switch_hist, sizeof hist);
+	intr_set_level (old_level);
+
+	printf ("Thread switch latency, in TSC cycles:\n");
+	for (i = 0; i < SWITCH_HIST_BUCKETS; i++)
+		if (hist[i] != 0)
+			printf ("  %s%12llu: %lld\n",
+					i == SWITCH_HIST_BUCKETS - 1 ? ">=" : "< ",
+					i == SWITCH_HIST_BUCKETS - 1 ? 1ULL << i : 2ULL << i,
+					hist[i]);
+}
+
+/* Charges the TSC cycles since it was last charged to the thread
+   running on CPU, to the statistics for its kind of thread.
+   Called at every thread switch, and at every tick so that a
+   long-running thread is not charged all at once. */
+static void
+charge_cycles (struct cpu *cpu) {
+	struct thread *t = cpu->curr;
+	uint64_t now = rdtsc ();
+	long long cycles = now - cpu->switch_tsc;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	cpu->switch_tsc = now;
+	if (t == cpu->idle_thread)
+		idle_cycles += cycles;
+#ifdef USERPROG
+	else if (t->process != NULL && t->process->pml4 != NULL)
+		user_cycles += cycles;
+#endif
+	else
+		kernel_cycles += cycles;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -196,25 +491,28 @@ thread_print_stats (void) {
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
-	struct thread *t;
+	struct thread *t, *first;
+	struct switch_frame *sf;
 	tid_t tid;
 	struct thread *cur_thread = thread_current();
+	enum intr_level old_level;
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_alloc ();
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+	t->cpu = cur_thread->cpu;
 
+	old_level = intr_disable ();
 	list_push_back(&all_list, &t->all_elem);
-
-	list_push_back(&cur_thread->child_list, &t->child_elem);
-	t->parent = cur_thread;
+	t->vruntime = cpu_ready_queue (t->cpu)->min_vruntime;
+	intr_set_level (old_level);
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -227,15 +525,21 @@ thread_create (const char *name, int priority,
 	t->tf.cs = SEL_KCSEG;
 	t->tf.eflags = FLAG_IF;
 
+	/* The first switch to the thread returns into switch_entry,
+	 * which enters kernel_thread() through do_iret(). */
+	sf = (struct switch_frame *) (t->tf.rsp - sizeof *sf);
+	sf->rbx = (uint64_t) &t->tf;
+	sf->rip = switch_entry;
+	t->switch_rsp = (uint64_t) sf;
+
 	/* Add to run queue. */
 	thread_unblock (t);
 
-	if(!list_empty(&ready_list))
-	{
-		struct thread *begin_thread = list_entry(list_begin(&ready_list), struct thread, elem);
-		if(cur_thread->priority <= begin_thread->priority)
-			thread_yield();
-	}
+	old_level = intr_disable ();
+	first = ready_queue_first (cpu_ready_queue (cur_thread->cpu));
+	intr_set_level (old_level);
+	if (first != NULL && !thread_runs_before (cur_thread, first))
+		thread_yield();
 
 	return tid;
 }
@@ -262,18 +566,30 @@ thread_block (void) {
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  If T goes to another CPU that should run
+   it right away, though, that CPU is interrupted to do so. */
 void
 thread_unblock (struct thread *t) {
 	enum intr_level old_level;
+	struct cpu *cpu;
 
 	ASSERT (is_thread (t));
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	// list_push_back (&ready_list, &t->elem);		// insert_order change
-	list_insert_ordered(&ready_list, &t->elem, compare_thread_priority, NULL);
+	if (thread_mlfqs)
+		t->priority = mlfqs_priority (t);
+	if (t->dl)
+		dl_wakeup (t);
+	cpu = select_cpu (t);
+	if (thread_cfs && !t->dl)
+		cfs_place (t, cpu);
+	t->cpu = cpu;
+	ready_queue_push (cpu_ready_queue (cpu), t);
 	t->status = THREAD_READY;
+	if (cpu != cpu_current ()
+			&& (cpu->curr == cpu->idle_thread || thread_runs_before (t, cpu->curr)))
+		lapic_send_ipi (cpu->lapic_id, LAPIC_RESCHED_VEC);
 	intr_set_level (old_level);
 }
 
@@ -295,6 +611,48 @@ compare_thread_origin_priority(struct list_elem *a, struct list_elem *b, void *a
 	return thread_a->origin_priority > thread_b->origin_priority;
 }
 
+/* Keeps the running thread from being preempted, that is, from
+   being switched out by an interrupt handler's request to yield,
+   until the matching call to thread_preempt_enable().  The
+   thread also stays on its CPU.  It must not block or yield
+   meanwhile.  Calls nest. */
+void
+thread_preempt_disable (void) {
+	thread_current ()->preempt_cnt++;
+	barrier ();
+}
+
+/* Undoes one call to thread_preempt_disable().  If that makes
+   the running thread preemptible again and an interrupt handler
+   asked for it to yield in the meantime, yields now. */
+void
+thread_preempt_enable (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (t->preempt_cnt > 0);
+
+	barrier ();
+	if (--t->preempt_cnt == 0 && t->preempt_pending) {
+		t->preempt_pending = false;
+		if (!intr_context ())
+			thread_yield ();
+	}
+}
+
+/* Yields on behalf of an interrupt handler that called
+   intr_yield_on_return(), or, if the running thread has
+   preemption disabled, leaves the yield to
+   thread_preempt_enable(). */
+void
+thread_preempt (void) {
+	struct thread *t = thread_current ();
+
+	if (t->preempt_cnt > 0)
+		t->preempt_pending = true;
+	else
+		thread_yield ();
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) {
@@ -310,9 +668,9 @@ thread_current (void) {
 
 	/* Make sure T is really a thread.
 	   If either of these assertions fire, then your thread may
-	   have overflowed its stack.  Each thread has less than 4 kB
-	   of stack, so a few big automatic arrays or moderate
-	   recursion can cause stack overflow. */
+	   have overflowed its stack.  Each thread has less than
+	   THREAD_STACK_SIZE of stack, so a few big automatic arrays or
+	   moderate recursion can cause stack overflow. */
 
 	ASSERT (is_thread (t));
 	ASSERT (t->status == THREAD_RUNNING);
@@ -335,17 +693,24 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	fpu_exit ();
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
 	list_remove(&thread_current()->all_elem);
+	if (thread_current ()->recent_cpu_changed)
+		list_remove (&thread_current ()->recent_cpu_elem);
+	if (thread_current ()->dl)
+		dl_leave (thread_current ());
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
-   may be scheduled again immediately at the scheduler's whim. */
+   may be scheduled again immediately at the scheduler's whim,
+   unless it is a deadline thread that has used up its budget,
+   which sleeps until its next period instead. */
 void
 thread_yield (void) {
 	struct thread *curr = thread_current ();
@@ -354,8 +719,17 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 	
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, compare_thread_priority, NULL);
+	if (curr->dl) {
+		dl_charge (curr);
+		if (curr->dl_budget <= 0) {
+			dl_throttle (curr);
+			intr_set_level (old_level);
+			return;
+		}
+	} else if (thread_cfs && curr != curr->cpu->idle_thread)
+		cfs_charge (curr);
+	if (curr != curr->cpu->idle_thread)
+		ready_queue_push (cpu_ready_queue (curr->cpu), curr);
 
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
@@ -370,6 +744,7 @@ thread_set_priority (int new_priority) {
 	enum intr_level old_level = intr_disable ();
 
 	struct thread *cur = thread_current();
+	struct thread *first;
 	struct list_elem *e = list_begin(&(cur->donation_list));
 
 	cur->origin_priority = new_priority;
@@ -381,26 +756,321 @@ thread_set_priority (int new_priority) {
 			cur->priority = t->priority;
 		e = e->next;
 	}
-	if (cur->priority < list_entry(list_begin(&ready_list), struct thread, elem)->priority) {
-		if (cur != idle_thread)
-			list_insert_ordered(&ready_list, &cur->elem, compare_thread_priority, NULL);
+	first = ready_queue_first (cpu_ready_queue (cur->cpu));
+	if (first != NULL && thread_runs_before (first, cur)) {
+		if (thread_cfs && !cur->dl && cur != cur->cpu->idle_thread)
+			cfs_charge (cur);
+		if (cur != cur->cpu->idle_thread)
+			ready_queue_push (cpu_ready_queue (cur->cpu), cur);
 		do_schedule (THREAD_READY);
 	}
 	intr_set_level (old_level);
 }
 
+/* Changes T's effective priority to PRIORITY, moving T to the
+   matching ready queue level if it is currently ready to run,
+   or to its new place among the waiters of the semaphore,
+   condition variable, or RW lock it is waiting on.  Used by
+   priority donation, by lock and RW lock release, which end
+   donations, and by the MLFQS recalculation.  Any priority
+   change that may affect a queued thread must go through here,
+   or the heap the thread is in goes out of order. */
+void
+thread_update_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->status == THREAD_READY && t->priority != priority) {
+		ready_queue_remove (cpu_ready_queue (t->cpu), t);
+		t->priority = priority;
+		ready_queue_push (cpu_ready_queue (t->cpu), t);
+	} else if ((t->blocked_heap != NULL || t->blocked_cond != NULL)
+			&& t->priority != priority)
+		synch_update_priority (t, priority);
+	else
+		t->priority = priority;
+	intr_set_level (old_level);
+}
+
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) {
 	return thread_current()->priority;
 }
 
+/* Returns true if A should run before B: a deadline thread runs
+   before any other thread, and before a deadline thread with a
+   later deadline.  Other threads go by priority, or with -cfs,
+   by vruntime, where A must be behind B by at least
+   CFS_WAKEUP_GRANULARITY so that threads do not preempt each
+   other back and forth. */
+bool
+thread_runs_before (const struct thread *a, const struct thread *b) {
+	if (a->dl != b->dl)
+		return a->dl;
+	if (a->dl)
+		return a->dl_abs_deadline < b->dl_abs_deadline;
+	if (thread_cfs)
+		return a->vruntime + CFS_WAKEUP_GRANULARITY < b->vruntime;
+	return a->priority > b->priority;
+}
+
+/* Moves the current thread into the deadline class, or changes
+   its parameters if it is already there.  From now on it is
+   given RUNTIME ns of CPU time in every PERIOD ns, to be used
+   within DEADLINE ns of the start of the period, ahead of every
+   thread outside the class.  Requires
+   0 < RUNTIME <= DEADLINE <= PERIOD <= 10 s.
+
+   Returns false, leaving the thread as it was, if the parameters
+   are out of range or if no CPU has enough time left to meet the
+   new deadlines as well as those it already promised. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) {
+	struct thread *cur = thread_current ();
+	struct cpu *best = NULL;
+	enum intr_level old_level;
+	uint64_t density;
+	bool was_dl;
+	int i;
+
+	ASSERT (!intr_context ());
+
+	if (runtime <= 0 || runtime > deadline || deadline > period
+			|| period > DL_PERIOD_MAX)
+		return false;
+	density = ((uint64_t) runtime << DL_SHIFT) / deadline;
+	if (density == 0)
+		density = 1;
+
+	old_level = intr_disable ();
+	was_dl = cur->dl;
+	if (was_dl)
+		dl_leave (cur);
+
+	/* Stay on this CPU if it has room, otherwise take the CPU
+	   with the most room left. */
+	if (dl_load[cur->cpu->id] + density <= DL_DENSITY_MAX)
+		best = cur->cpu;
+	else
+		for (i = 0; i < cpu_cnt; i++)
+			if (dl_load[i] + density <= DL_DENSITY_MAX
+					&& (best == NULL || dl_load[i] < dl_load[best->id]))
+				best = &cpus[i];
+	if (best == NULL) {
+		if (was_dl) {
+			cur->dl = true;
+			dl_load[cur->dl_cpu->id] += cur->dl_density;
+		}
+		intr_set_level (old_level);
+		return false;
+	}
+
+	cur->dl = true;
+	cur->dl_runtime = runtime;
+	cur->dl_deadline = deadline;
+	cur->dl_period = period;
+	cur->dl_density = density;
+	cur->dl_cpu = best;
+	cur->exec_start = timer_ns ();
+	cur->dl_abs_deadline = cur->exec_start + deadline;
+	cur->dl_budget = runtime;
+	dl_load[best->id] += density;
+
+	/* Move to the CPU admitted on. */
+	if (best != cur->cpu) {
+		ready_queue_push (cpu_ready_queue (best), cur);
+		if (best->curr == best->idle_thread
+				|| thread_runs_before (cur, best->curr))
+			lapic_send_ipi (best->lapic_id, LAPIC_RESCHED_VEC);
+		do_schedule (THREAD_READY);
+	}
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Moves the current thread out of the deadline class, back to
+   being scheduled by its priority. */
+void
+thread_clear_deadline (void) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	if (cur->dl) {
+		dl_leave (cur);
+		if (thread_cfs)
+			cfs_place (cur, cur->cpu);
+	}
+	intr_set_level (old_level);
+	thread_yield ();
+}
+
+/* Gives up the rest of the current deadline thread's budget and
+   sleeps until its next period.  A periodic thread calls this
+   after finishing each job. */
+void
+thread_deadline_yield (void) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+	ASSERT (cur->dl);
+
+	old_level = intr_disable ();
+	dl_throttle (cur);
+	intr_set_level (old_level);
+}
+
+/* Charges deadline thread T, which is running, for the time since
+   it was last charged. */
+static void
+dl_charge (struct thread *t) {
+	int64_t now = timer_ns ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->dl_budget -= now - t->exec_start;
+	t->exec_start = now;
+}
+
+/* Called when deadline thread T wakes up.  Keeps T's deadline and
+   budget if T can use up the budget before the deadline without
+   running at more than its density, or else replaces them by a
+   fresh budget and a deadline DEADLINE from now. */
+static void
+dl_wakeup (struct thread *t) {
+	int64_t now = timer_ns ();
+
+	if (now >= t->dl_abs_deadline
+			|| (__int128) t->dl_budget * t->dl_deadline
+				> (__int128) (t->dl_abs_deadline - now) * t->dl_runtime) {
+		t->dl_abs_deadline = now + t->dl_deadline;
+		t->dl_budget = t->dl_runtime;
+	}
+}
+
+/* Puts the running deadline thread T to sleep until the start of
+   its next period, the timer tick after it to be exact, when
+   dl_wakeup() gives it a new budget and deadline.  If the next
+   period has already started, T just yields with the new budget.
+   Interrupts must be off. */
+static void
+dl_throttle (struct thread *t) {
+	int64_t next = t->dl_abs_deadline - t->dl_deadline + t->dl_period;
+	int64_t now = timer_ns ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->dl_budget = 0;
+	t->dl_abs_deadline = now;
+	if (next > now)
+		thread_sleep (timer_ticks () + 1 + (next - now) / TIMER_NS_PER_TICK);
+	else {
+		dl_wakeup (t);
+		ready_queue_push (cpu_ready_queue (t->cpu), t);
+		do_schedule (THREAD_READY);
+	}
+}
+
+/* Moves T, the running thread, out of the deadline class and
+   gives back the time it was admitted with. */
+static void
+dl_leave (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->dl);
+
+	dl_load[t->dl_cpu->id] -= t->dl_density;
+	t->dl = false;
+}
+
+/* Orders deadline threads by absolute deadline. */
+static bool
+dl_deadline_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, dl_elem)->dl_abs_deadline
+		< heap_entry (b, struct thread, dl_elem)->dl_abs_deadline;
+}
+
+/* Charges T, the running thread, for the time since it was last
+   charged, weighted by its nice value, and moves its CPU's
+   min_vruntime forward to match. */
+static void
+cfs_charge (struct thread *t) {
+	struct ready_queue *rq = cpu_ready_queue (t->cpu);
+	int64_t now = timer_ns ();
+	int nice = t->nice;
+	int64_t min;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	if (nice > NICE_MAX)
+		nice = NICE_MAX;
+	t->vruntime += (now - t->exec_start) * NICE_0_WEIGHT
+		/ nice_weights[nice - NICE_MIN];
+	t->exec_start = now;
+
+	min = t->vruntime;
+	if (!heap_empty (&rq->fair)) {
+		int64_t first = heap_entry (heap_min (&rq->fair), struct thread,
+				fair_elem)->vruntime;
+		if (first < min)
+			min = first;
+	}
+	if (min > rq->min_vruntime)
+		rq->min_vruntime = min;
+}
+
+/* Sets the vruntime of T, which is waking up, for joining CPU's
+   ready queue: carried over relative to min_vruntime if T last
+   ran on another CPU, and no more than CFS_LATENCY / 2 behind. */
+static void
+cfs_place (struct thread *t, struct cpu *cpu) {
+	struct ready_queue *rq = cpu_ready_queue (cpu);
+
+	if (t->cpu != NULL && t->cpu != cpu)
+		t->vruntime += rq->min_vruntime - cpu_ready_queue (t->cpu)->min_vruntime;
+	if (t->vruntime < rq->min_vruntime - CFS_LATENCY / 2)
+		t->vruntime = rq->min_vruntime - CFS_LATENCY / 2;
+}
+
+/* Returns how long, in ns, the thread running on CPU may run
+   before it yields to the next one. */
+static int64_t
+cfs_slice (struct cpu *cpu) {
+	int64_t slice = CFS_LATENCY / (heap_size (&cpu_ready_queue (cpu)->fair) + 1);
+
+	return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+/* Orders threads by vruntime. */
+static bool
+vruntime_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, fair_elem)->vruntime
+		< heap_entry (b, struct thread, fair_elem)->vruntime;
+}
+
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
-	return thread_current()->nice = nice;
-	// priority recalculate
+thread_set_nice (int nice) {
+	enum intr_level old_level = intr_disable ();
+
+	/* Charge the time run so far at the old weight. */
+	if (thread_cfs && !thread_current ()->dl)
+		cfs_charge (thread_current ());
+
+	/* The new priority takes effect at the next priority update. */
+	thread_current ()->nice = nice;
+	recent_cpu_mark_changed (thread_current ());
+	intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
@@ -428,38 +1098,43 @@ thread_get_recent_cpu (void) {
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes the boot CPU's idle_thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when the ready list is
+   empty.  The idle threads of the other CPUs are set up by
+   thread_prepare_ap() instead. */
 static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
+	struct thread *t = thread_current ();
 
-	idle_thread = thread_current ();
+	t->cpu->idle_thread = t;
 	sema_up (idle_started);
 
-	list_remove(&idle_thread->all_elem);
+	list_remove(&t->all_elem);
+
+	idle_loop ();
+}
 
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void) {
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
 		thread_block ();
 
-		/* Re-enable interrupts and wait for the next one.
-
-		   The `sti' instruction disables interrupts until the
-		   completion of the next instruction, so these two
-		   instructions are executed atomically.  This atomicity is
-		   important; otherwise, an interrupt could be handled
-		   between re-enabling interrupts and waiting for the next
-		   one to occur, wasting as much as one clock tick worth of
-		   time.
+		/* In tickless mode, stop the periodic tick until the
+		   earliest sleeping thread is due. */
+		timer_idle_enter ();
 
-		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
-		asm volatile ("sti; hlt" : : : "memory");
+		/* Re-enable interrupts and wait for the next one.  Doing
+		   both at once is important; otherwise, an interrupt could
+		   be handled in between, wasting as much as one clock tick
+		   worth of time. */
+		intr_wait ();
 	}
 }
 
@@ -485,25 +1160,15 @@ init_thread (struct thread *t, const char *name, int priority) {
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);		// 현재 스레드의 스택이 시작되는 주소
+	t->tf.rsp = (uint64_t) t + THREAD_STACK_SIZE - sizeof (void *);		// 현재 스레드의 스택이 시작되는 주소
 	t->priority = priority;
 	t->wait_on_lock = NULL;
 	list_init(&t->donation_list);
+	list_init (&t->rw_holds);
 	t->origin_priority = priority;
 	t->nice = NICE_DEFAULT;
 	t->recent_cpu = RECENT_CPU_DEFAULT;
-	t->exit_status = 0;
-	#ifdef USERPROG
-		t->fd = 3;
-	#endif
-	memset(t->file_table, 0, sizeof(t->file_table));
-	sema_init(&t->wait_sema, 0);
-	sema_init(&t->exit_sema, 0);
-	sema_init(&t->fork_sema, 0);
-	list_init(&t->child_list);
-	t->exit_status = ALIVE_CHILD;
-	t->is_wait = false;
-	t->parent = NULL;
+	t->recent_cpu_epoch = decay_epoch;
 	t->magic = THREAD_MAGIC;
 
 }
@@ -511,14 +1176,220 @@ init_thread (struct thread *t, const char *name, int priority) {
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   will be in the run queue.)  If the run queue is empty, try to
+   steal a thread from another CPU, and if there is none to steal,
+   return the CPU's idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct cpu *cpu = cpu_current ();
+	struct ready_queue *rq = cpu_ready_queue (cpu);
+	struct thread *t;
+
+	if (rq->cnt != 0)
+		return ready_queue_pop (rq);
+
+	t = steal_thread (cpu, 0);
+	if (t != NULL)
+		return t;
+	return cpu->idle_thread;
+}
+
+/* Initializes ready queue RQ as empty. */
+static void
+ready_queue_init (struct ready_queue *rq) {
+	int pri;
+
+	heap_init (&rq->dl, dl_deadline_less, NULL);
+	heap_init (&rq->fair, vruntime_less, NULL);
+	rq->min_vruntime = 0;
+	for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&rq->lists[pri]);
+	rq->mask = 0;
+	rq->cnt = 0;
+}
+
+/* Adds T to RQ: to the deadline heap if T is a deadline thread,
+   to the fair heap with -cfs, or else to the back of RQ's list
+   for T's priority. */
+static void
+ready_queue_push (struct ready_queue *rq, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	if (t->dl)
+		heap_push (&rq->dl, &t->dl_elem);
+	else if (thread_cfs)
+		heap_push (&rq->fair, &t->fair_elem);
+	else {
+		list_push_back (&rq->lists[t->priority], &t->elem);
+		rq->mask |= 1ULL << t->priority;
+	}
+	rq->cnt++;
+}
+
+/* Removes T, which must be queued in RQ at its current priority. */
+static void
+ready_queue_remove (struct ready_queue *rq, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->dl)
+		heap_remove (&rq->dl, &t->dl_elem);
+	else if (thread_cfs)
+		heap_remove (&rq->fair, &t->fair_elem);
+	else {
+		list_remove (&t->elem);
+		if (list_empty (&rq->lists[t->priority]))
+			rq->mask &= ~(1ULL << t->priority);
+	}
+	rq->cnt--;
+}
+
+/* Returns the thread that RQ would run next without removing it:
+   the deadline thread with the earliest deadline, if any, or else
+   as ready_queue_first_movable().  Returns a null pointer if RQ
+   is empty. */
+static struct thread *
+ready_queue_first (struct ready_queue *rq) {
+	if (!heap_empty (&rq->dl))
+		return heap_entry (heap_min (&rq->dl), struct thread, dl_elem);
+	return ready_queue_first_movable (rq);
+}
+
+/* Returns the thread outside the deadline class that RQ would run
+   next: the one with the least vruntime with -cfs, or else the
+   oldest thread of the highest non-empty priority level.  Returns
+   a null pointer if there is none. */
+static struct thread *
+ready_queue_first_movable (struct ready_queue *rq) {
+	if (!heap_empty (&rq->fair))
+		return heap_entry (heap_min (&rq->fair), struct thread, fair_elem);
+	if (rq->mask == 0)
+		return NULL;
+	return list_entry (list_front (&rq->lists[ready_queue_max_priority (rq)]),
+			struct thread, elem);
+}
+
+/* Removes and returns the thread that RQ, which must not be
+   empty, should run next. */
+static struct thread *
+ready_queue_pop (struct ready_queue *rq) {
+	struct thread *t = ready_queue_first (rq);
+
+	ASSERT (t != NULL);
+
+	ready_queue_remove (rq, t);
+	return t;
+}
+
+/* Returns the highest priority with a thread queued in RQ's
+   lists, or PRI_MIN - 1 if they are empty. */
+static int
+ready_queue_max_priority (const struct ready_queue *rq) {
+	if (rq->mask == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll (rq->mask);
+}
+
+/* Returns CPU's ready queue. */
+static struct ready_queue *
+cpu_ready_queue (const struct cpu *cpu) {
+	return &ready_queues[cpu->id];
+}
+
+/* Returns true if CPU is running its idle thread with nothing
+   queued. */
+static bool
+cpu_is_idle (const struct cpu *cpu) {
+	return cpu->started && cpu->curr == cpu->idle_thread
+		&& cpu_ready_queue (cpu)->cnt == 0;
+}
+
+/* Chooses the CPU whose ready queue T should join: the CPU it
+   last ran on, whose cache may still hold its working set, unless
+   that CPU is busy and another one is idle.  A deadline thread
+   always goes to the CPU it was admitted to. */
+static struct cpu *
+select_cpu (struct thread *t) {
+	struct cpu *last = t->cpu != NULL ? t->cpu : cpu_current ();
+	int i;
+
+	if (t->dl)
+		return t->dl_cpu;
+
+	if (cpu_is_idle (last))
+		return last;
+	for (i = 0; i < cpu_cnt; i++)
+		if (cpu_is_idle (&cpus[i]))
+			return &cpus[i];
+	return last;
+}
+
+/* Returns the number of threads that CPU has to run: those in its
+   ready queue plus the running one, unless that is the idle
+   thread. */
+static int
+cpu_load (const struct cpu *cpu) {
+	return cpu_ready_queue (cpu)->cnt + (cpu->curr != cpu->idle_thread);
+}
+
+/* Takes the ready thread that would run next outside the deadline
+   class from the busiest other CPU, if that CPU's load is at least
+   LOAD + 2, so that moving one thread makes the two loads closer.
+   The thread is handed to CPU but not queued.  Returns the thread,
+   or a null pointer if no CPU is busy enough.
+
+   Any ready thread outside the deadline class may migrate: a
+   thread is only tied to its CPU while it runs there.  Deadline
+   threads stay on the CPU they were admitted to, and the idle
+   threads never enter a ready queue, so they are never taken. */
+static struct thread *
+steal_thread (struct cpu *cpu, int load) {
+	struct cpu *busiest = NULL;
+	int busiest_load = load + 1;
+	struct ready_queue *rq;
+	struct thread *t;
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (i = 0; i < cpu_cnt; i++) {
+		struct cpu *victim = &cpus[i];
+		int victim_load;
+
+		if (victim == cpu
+				|| ready_queue_first_movable (cpu_ready_queue (victim)) == NULL)
+			continue;
+		victim_load = cpu_load (victim);
+		if (victim_load > busiest_load) {
+			busiest = victim;
+			busiest_load = victim_load;
+		}
+	}
+	if (busiest == NULL)
+		return NULL;
+
+	rq = cpu_ready_queue (busiest);
+	t = ready_queue_first_movable (rq);
+	ready_queue_remove (rq, t);
+	if (thread_cfs)
+		t->vruntime += cpu_ready_queue (cpu)->min_vruntime - rq->min_vruntime;
+	t->cpu = cpu;
+	return t;
+}
+
+/* Periodic load balancing, called from thread_tick() on CPU.
+   Pulls one thread from the busiest CPU if it has at least two
+   more threads than CPU, and preempts the running thread if the
+   newcomer should run first. */
+static void
+rebalance (struct cpu *cpu) {
+	struct thread *t = steal_thread (cpu, cpu_load (cpu));
+
+	if (t == NULL)
+		return;
+	ready_queue_push (cpu_ready_queue (cpu), t);
+	if (cpu->curr == cpu->idle_thread || thread_runs_before (t, cpu->curr))
+		intr_yield_on_return ();
 }
 
 /* Use iretq to launch the thread */
@@ -549,12 +1420,18 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches from the running thread to TH, which was either
+   switched out by an earlier call or set up by thread_create().
+   To the compiler this is an ordinary call, so switch_context()
+   only keeps the callee-saved registers; anything else that
+   matters is in registers the caller assumes clobbered, or in the
+   intr_frame on the stack when the switch happens on the way out
+   of an interrupt.  Only a new thread's first entry goes through
+   do_iret(), to load the full intr_frame that thread_create()
+   built.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   At this function's invocation, interrupts are disabled, and
+   they still are when the switch back to this thread returns.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
@@ -562,61 +1439,10 @@ do_iret (struct intr_frame *tf) {
 // 컨텍스트 스위칭
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (th->switch_rsp != 0);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	switch_context (&running_thread ()->switch_rsp, th->switch_rsp);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -627,28 +1453,135 @@ static void
 do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
-	}
+	if (!list_empty (&destruction_req))
+		queue_work (&reaper_wq, &reap_work);
 	thread_current ()->status = status;
 	schedule ();
 }
 
+/* Frees the blocks of the threads that have exited.  Runs on
+   reaper_wq, so that do_schedule() does not free pages with
+   interrupts off. */
+static void
+reap_threads (struct work *w UNUSED) {
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		struct thread *victim = NULL;
+
+		if (!list_empty (&destruction_req))
+			victim = list_entry (list_pop_front (&destruction_req),
+					struct thread, elem);
+		intr_set_level (old_level);
+
+		if (victim == NULL)
+			break;
+		thread_free (victim);
+	}
+}
+
+/* Returns a thread block, not initialized, from the cache if
+   possible, or else newly allocated with its guard page unmapped.
+   Returns a null pointer if memory is short. */
+static struct thread *
+thread_alloc (void) {
+	enum intr_level old_level;
+	struct thread *t = NULL;
+	uint8_t *pages, *guard, *end;
+	uint64_t *pte;
+
+	old_level = intr_disable ();
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+	} else if (!list_empty (&destruction_req))
+		t = list_entry (list_pop_front (&destruction_req), struct thread, elem);
+	intr_set_level (old_level);
+	if (t != NULL)
+		return t;
+
+	/* The page allocator aligns a block only to its own size, which
+	   leaves no room for the guard page, so take twice as many pages
+	   as needed and give back what is left around the aligned block
+	   and the page below it. */
+	pages = palloc_get_multiple (0, 2 * THREAD_STACK_PAGES);
+	if (pages == NULL)
+		return NULL;
+	t = (struct thread *) ROUND_UP ((uint64_t) pages + PGSIZE, THREAD_STACK_SIZE);
+	guard = (uint8_t *) t - PGSIZE;
+	end = pages + 2 * THREAD_STACK_SIZE;
+	palloc_free_multiple (pages, (guard - pages) / PGSIZE);
+	palloc_free_multiple ((uint8_t *) t + THREAD_STACK_SIZE,
+			(end - ((uint8_t *) t + THREAD_STACK_SIZE)) / PGSIZE);
+
+	/* Other CPUs may still have the guard page in their TLBs for a
+	   while, which only delays the protection there. */
+	pte = pml4e_walk (base_pml4, (uint64_t) guard, 0);
+	ASSERT (pte != NULL && (*pte & PTE_P));
+	*pte &= ~PTE_P;
+	invlpg ((uint64_t) guard);
+	return t;
+}
+
+/* Puts T, the block of a thread that has exited, in the cache, or
+   frees it with its guard page if the cache is full. */
+static void
+thread_free (struct thread *t) {
+	enum intr_level old_level;
+	uint8_t *guard = (uint8_t *) t - PGSIZE;
+	uint64_t *pte;
+
+	old_level = intr_disable ();
+	if (thread_cache_cnt < THREAD_CACHE_MAX) {
+		list_push_front (&thread_cache, &t->elem);
+		thread_cache_cnt++;
+		t = NULL;
+	}
+	intr_set_level (old_level);
+	if (t == NULL)
+		return;
+
+	/* Map the guard page again before the page allocator writes to
+	   it.  A page that is not present is never in a TLB. */
+	pte = pml4e_walk (base_pml4, (uint64_t) guard, 0);
+	*pte |= PTE_P;
+	palloc_free_multiple (guard, THREAD_STACK_PAGES + 1);
+}
+
 static void
 schedule (void) {
+	uint64_t start = rdtsc ();
 	struct thread *curr = running_thread ();
+	struct cpu *cpu = curr->cpu;
 	struct thread *next = next_thread_to_run ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
+	ASSERT (curr->preempt_cnt == 0);
 	ASSERT (is_thread (next));
+	charge_cycles (cpu);
+	if (curr->dl)
+		dl_charge (curr);
+	else if (thread_cfs && curr != cpu->idle_thread
+			&& curr->status != THREAD_READY)
+		cfs_charge (curr);        /* Charged before it was queued. */
+	if (next->dl || thread_cfs)
+		next->exec_start = timer_ns ();
+
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	next->cpu = cpu;
+	cpu->curr = next;
+
+	/* A thread switch is an RCU quiescent state. */
+	cpu->rcu_qs_cnt++;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	cpu->thread_ticks = 0;
+
+	/* Leaving the idle thread, possibly straight from the interrupt
+	   that woke it: bring back the periodic tick. */
+	if (curr == cpu->idle_thread)
+		timer_idle_exit ();
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -661,8 +1594,7 @@ schedule (void) {
 		   pull out the rug under itself.
 		   We just queuing the page free reqeust here because the page is
 		   currently used by the stack.
-		   The real destruction logic will be called at the beginning of the
-		   schedule(). */
+		   The next do_schedule() hands it to reap_threads(). */
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
 			list_push_back (&destruction_req, &curr->elem);
@@ -670,21 +1602,28 @@ schedule (void) {
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
+		fpu_switch (curr);
+		record_switch (rdtsc () - start);
 		thread_launch (next);
 	}
 }
 
+/* Counts a thread switch that took CYCLES in switch_hist. */
+static void
+record_switch (uint64_t cycles) {
+	int bucket = cycles > 1 ? 63 - __builtin_clzll (cycles) : 0;
+
+	if (bucket >= SWITCH_HIST_BUCKETS)
+		bucket = SWITCH_HIST_BUCKETS - 1;
+	switch_hist[bucket]++;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
 	static tid_t next_tid = 1;
-	tid_t tid;
-
-	lock_acquire (&tid_lock);
-	tid = next_tid++;
-	lock_release (&tid_lock);
 
-	return tid;
+	return __atomic_fetch_add (&next_tid, 1, __ATOMIC_RELAXED);
 }
 
 void
@@ -693,11 +1632,13 @@ thread_sleep(int64_t sleep_tick)
 	enum intr_level origin_level = intr_disable();
 	struct thread *cur_thread = thread_current();
 
-	if(cur_thread != idle_thread)
+	if(cur_thread != cur_thread->cpu->idle_thread)
 	{
 		cur_thread->status = THREAD_BLOCKED;
 		cur_thread->awake_tick = sleep_tick;
-		list_push_back(&sleep_list, &cur_thread->elem);
+		heap_push(&sleep_queue, &cur_thread->sleep_elem);
+		if(sleep_tick < next_awake_tick)
+			next_awake_tick = sleep_tick;
 	}
 
 	schedule();
@@ -705,55 +1646,80 @@ thread_sleep(int64_t sleep_tick)
 	intr_set_level(origin_level);
 }
 
+/* Wakes up every sleeping thread whose awake_tick is at or
+   before CUR_TICK.  Called on every timer tick, so the common case
+   of nobody being due is a single comparison. */
 void
 thread_awake(int64_t cur_tick)
 {
-	struct list_elem *temp_element;
 	enum intr_level origin_level;
 
-	if(list_empty(&sleep_list))
+	if(cur_tick < next_awake_tick)
 		return;
 
 	origin_level = intr_disable();
 
-	temp_element = list_begin(&sleep_list);
-
-	while(temp_element != list_end(&sleep_list))
+	while(!heap_empty(&sleep_queue))
 	{
-		struct thread *temp_thread = list_entry(temp_element, struct thread, elem);
-		if(temp_thread->awake_tick <= cur_tick)
-		{
-			temp_element = list_remove(temp_element);
-			thread_unblock(temp_thread);
-		}
-		else
-			temp_element = list_next(temp_element);
+		struct thread *temp_thread = heap_entry(heap_min(&sleep_queue), struct thread, sleep_elem);
+		if(temp_thread->awake_tick > cur_tick)
+			break;
+		heap_pop_min(&sleep_queue);
+		thread_unblock(temp_thread);
+		if(intr_context() && temp_thread->cpu == cpu_current()
+				&& thread_runs_before(temp_thread, cpu_current()->curr))
+			intr_yield_on_return();
 	}
 
+	next_awake_tick = heap_empty(&sleep_queue) ? INT64_MAX
+		: heap_entry(heap_min(&sleep_queue), struct thread, sleep_elem)->awake_tick;
+
 	intr_set_level(origin_level);
 }
 
+/* Returns the earliest awake_tick of any sleeping thread, or
+   INT64_MAX if no thread is sleeping. */
+int64_t
+thread_next_awake_tick (void)
+{
+	return next_awake_tick;
+}
+
+/* Orders sleeping threads by awake_tick. */
+static bool
+awake_tick_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry(a, struct thread, sleep_elem)->awake_tick
+		< heap_entry(b, struct thread, sleep_elem)->awake_tick;
+}
+
+/* Charges the running thread for the current tick.  Called on
+   every CPU's timer interrupt. */
 void
 increase_recent_cpu(void)
 {
 	struct thread 		*cur_thread = thread_current();
 	int					recent = cur_thread->recent_cpu;
 
-	if(cur_thread != idle_thread)
+	if(cur_thread != cur_thread->cpu->idle_thread)
+	{
 		cur_thread->recent_cpu = add_mixed(recent, 1);
-
+		recent_cpu_mark_changed(cur_thread);
+	}
 }
 
+/* Recomputes the priority of every thread whose recent_cpu or
+   nice changed since the last call, which is normally just the
+   threads that ran during the last 4 ticks. */
 void
 recalculate_priority(void)
 {
-	struct list_elem	*temp_elem;
-
-	for(temp_elem = list_begin(&all_list); temp_elem != list_end(&all_list); temp_elem = list_next(temp_elem))
+	while(!list_empty(&recent_cpu_changed))
 	{
-		struct thread	*temp_thread = list_entry(temp_elem, struct thread, all_elem);
+		struct thread	*temp_thread = list_entry(list_front(&recent_cpu_changed),
+				struct thread, recent_cpu_elem);
 
-		temp_thread->priority = priority_cal(temp_thread->recent_cpu, temp_thread->nice);
+		thread_update_priority(temp_thread, mlfqs_priority(temp_thread));
 	}
 }
 
@@ -764,21 +1730,100 @@ priority_cal(int recent, int nice)
 	int fp_pri_max = int_to_fp(PRI_MAX);
 	int sub_recent_from_max = sub_fp(fp_pri_max, fp_recent_cpu);
 
-	return fp_to_int_round(sub_mixed(sub_recent_from_max, (nice * 2)));
+	int priority = fp_to_int_round(sub_mixed(sub_recent_from_max, (nice * 2)));
+
+	if(priority > PRI_MAX)
+		return PRI_MAX;
+	if(priority < PRI_MIN)
+		return PRI_MIN;
+	return priority;
 }
 
+/* Decays recent_cpu once a second.  Only the running and ready
+   threads are brought up to date, and their priorities with
+   them; blocked threads catch up in thread_unblock().  Must be
+   called right after recalculate_load_avg(). */
 void
 recalculate_recent_cpu(void)
 {
-	struct list_elem	*temp_elem;
+	int					i;
+
+	load_avg_history[decay_epoch % DECAY_HISTORY] = load_avg;
+	decay_epoch++;
+
+	for(i = 0; i < cpu_cnt; i++)
+	{
+		struct thread	*temp_thread = cpus[i].curr;
+
+		if(temp_thread != cpus[i].idle_thread)
+			thread_update_priority(temp_thread, mlfqs_priority(temp_thread));
+		ready_queue_decay(&ready_queues[i]);
+	}
+}
+
+/* Applies the recent_cpu decays that T has missed since it was
+   last brought up to date. */
+static void
+recent_cpu_catch_up (struct thread *t)
+{
+	int64_t				epoch = t->recent_cpu_epoch;
+
+	if(decay_epoch - epoch > DECAY_HISTORY)
+		epoch = decay_epoch - DECAY_HISTORY;
+	for(; epoch < decay_epoch; epoch++)
+		t->recent_cpu = recent_cpu_cal(t->recent_cpu,
+				load_avg_history[epoch % DECAY_HISTORY], t->nice);
+	t->recent_cpu_epoch = decay_epoch;
+}
+
+/* Queues T for the next recalculate_priority(), if it is not
+   queued already. */
+static void
+recent_cpu_mark_changed (struct thread *t)
+{
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if(!t->recent_cpu_changed)
+	{
+		t->recent_cpu_changed = true;
+		list_push_back(&recent_cpu_changed, &t->recent_cpu_elem);
+	}
+}
+
+/* Brings T's recent_cpu up to date and returns T's MLFQS
+   priority.  Takes T off the recent_cpu_changed list, since
+   its priority is about to be current. */
+static int
+mlfqs_priority (struct thread *t)
+{
+	recent_cpu_catch_up(t);
+	if(t->recent_cpu_changed)
+	{
+		t->recent_cpu_changed = false;
+		list_remove(&t->recent_cpu_elem);
+	}
+	return priority_cal(t->recent_cpu, t->nice);
+}
+
+/* Brings every thread in RQ up to date and requeues it at its
+   new priority.  Threads are taken out highest priority first
+   and put back in the same order, so threads that stay at the
+   same level keep their round-robin order. */
+static void
+ready_queue_decay (struct ready_queue *rq)
+{
+	struct list			threads;
 
-	for(temp_elem = list_begin(&all_list); temp_elem != list_end(&all_list); temp_elem = list_next(temp_elem))
+	list_init(&threads);
+	while(rq->cnt != 0)
+		list_push_back(&threads, &ready_queue_pop(rq)->elem);
+	while(!list_empty(&threads))
 	{
-		struct thread	*temp_thread = list_entry(temp_elem, struct thread, all_elem);
-		int 			nice = temp_thread->nice;
-		int				recent_cpu = temp_thread->recent_cpu;
+		struct thread	*temp_thread = list_entry(list_pop_front(&threads),
+				struct thread, elem);
 
-		temp_thread->recent_cpu = recent_cpu_cal(recent_cpu, load_avg, nice);
+		temp_thread->priority = mlfqs_priority(temp_thread);
+		ready_queue_push(rq, temp_thread);
 	}
 }
 
@@ -793,9 +1838,17 @@ recent_cpu_cal(int recent_cpu, int load_avg, int nice)
 void
 recalculate_load_avg(void)
 {
-	struct thread		*cur_thread			 = thread_current();
-	int					size				 = list_size(&ready_list);
-	int 				ready_threads_count	 = cur_thread == idle_thread ? size : size + 1;
+	int 				ready_threads_count	 = 0;
+	int					i;
+
+	/* Ready threads on every CPU, plus every running thread other
+	   than the idle threads. */
+	for(i = 0; i < cpu_cnt; i++)
+	{
+		ready_threads_count += ready_queues[i].cnt;
+		if(cpus[i].curr != cpus[i].idle_thread)
+			ready_threads_count++;
+	}
 	
 	load_avg = load_avg_cal(load_avg, ready_threads_count);
 }
@@ -0,0 +1,234 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Worker threads are blocked on their workqueue's `idle' list,
+   rather than on a semaphore, so that queue_work() wakes one
+   with thread_unblock(), which never yields.  That makes
+   queue_work() safe to call anywhere, even on the way into the
+   scheduler.  All of this is protected by turning interrupts
+   off. */
+
+/* Minimum number of system_wq workers.  More are started on
+   machines with more CPUs, one per CPU. */
+#define SYSTEM_WORKERS_MIN 2
+
+struct workqueue system_wq = {
+	.name = "kworker",
+	.pending = LIST_INITIALIZER (system_wq.pending),
+	.idle = LIST_INITIALIZER (system_wq.idle),
+	.nice = NICE_DEFAULT,
+};
+
+/* Delayed work not yet due, ordered by due_tick, and the earliest
+   due_tick among it (INT64_MAX if none), so that the timer
+   interrupt only touches the heap when something is due. */
+static struct heap delayed_heap;
+static int64_t next_due_tick;
+
+static void start_workers (struct workqueue *, int worker_cnt, int priority);
+static thread_func worker;
+static heap_less_func due_tick_less;
+
+/* Initializes the delayed work heap.  Must be called before
+   queue_delayed_work(). */
+void
+workqueue_init (void) {
+	heap_init (&delayed_heap, due_tick_less, NULL);
+	next_due_tick = INT64_MAX;
+}
+
+/* Starts system_wq's worker threads.  Call after smp_init(), so
+   that there is one worker per CPU. */
+void
+workqueue_start (void) {
+	start_workers (&system_wq,
+			cpu_cnt > SYSTEM_WORKERS_MIN ? cpu_cnt : SYSTEM_WORKERS_MIN,
+			PRI_DEFAULT);
+}
+
+/* Initializes WQ as a workqueue named NAME, run by WORKER_CNT
+   kernel threads of the given PRIORITY. */
+void
+workqueue_create (struct workqueue *wq, const char *name,
+		int worker_cnt, int priority) {
+	ASSERT (wq != NULL);
+	ASSERT (name != NULL);
+
+	wq->name = name;
+	list_init (&wq->pending);
+	list_init (&wq->idle);
+	wq->nice = NICE_DEFAULT;
+	start_workers (wq, worker_cnt, priority);
+}
+
+/* Initializes WQ as a workqueue named NAME, run by one kernel
+   thread that should get the CPU only when other threads do not
+   want it.  The worker has priority PRI_MIN, which is all that
+   the priority scheduler looks at, and nice value NICE_MAX, which
+   keeps it below busy threads under -mlfqs and -cfs, where
+   priorities are computed or ignored. */
+void
+workqueue_create_idle (struct workqueue *wq, const char *name) {
+	ASSERT (wq != NULL);
+	ASSERT (name != NULL);
+
+	wq->name = name;
+	list_init (&wq->pending);
+	list_init (&wq->idle);
+	wq->nice = NICE_MAX;
+	start_workers (wq, 1, PRI_MIN);
+}
+
+/* Initializes W to call FUNC when run. */
+void
+work_init (struct work *w, work_func *func) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->pending = false;
+}
+
+/* Queues W on WQ.  Returns true if successful, false if W was
+   already pending.  May be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *w) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (w != NULL);
+
+	old_level = intr_disable ();
+	if (!w->pending) {
+		w->pending = true;
+		list_push_back (&wq->pending, &w->elem);
+		if (!list_empty (&wq->idle))
+			thread_unblock (list_entry (list_pop_front (&wq->idle),
+						struct thread, elem));
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Initializes DW to call FUNC when run. */
+void
+delayed_work_init (struct delayed_work *dw, work_func *func) {
+	ASSERT (dw != NULL);
+
+	work_init (&dw->work, func);
+	dw->wq = NULL;
+	dw->waiting = false;
+}
+
+/* Queues DW on WQ once TICKS timer ticks have passed.  Returns
+   true if successful, false if DW was already waiting or
+   pending.  May be called from an interrupt handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct delayed_work *dw,
+		int64_t ticks) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (dw != NULL);
+
+	if (ticks <= 0)
+		return queue_work (wq, &dw->work);
+
+	old_level = intr_disable ();
+	if (!dw->waiting && !dw->work.pending) {
+		dw->wq = wq;
+		dw->due_tick = timer_ticks () + ticks;
+		dw->waiting = true;
+		heap_push (&delayed_heap, &dw->timer_elem);
+		if (dw->due_tick < next_due_tick)
+			next_due_tick = dw->due_tick;
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Queues the delayed work that is due by tick NOW.  Called by the
+   timer interrupt handler on every tick. */
+void
+workqueue_tick (int64_t now) {
+	if (now < next_due_tick)
+		return;
+
+	while (!heap_empty (&delayed_heap)) {
+		struct delayed_work *dw = heap_entry (heap_min (&delayed_heap),
+				struct delayed_work, timer_elem);
+
+		if (dw->due_tick > now)
+			break;
+		heap_pop_min (&delayed_heap);
+		dw->waiting = false;
+		queue_work (dw->wq, &dw->work);
+	}
+
+	next_due_tick = heap_empty (&delayed_heap) ? INT64_MAX
+		: heap_entry (heap_min (&delayed_heap), struct delayed_work,
+				timer_elem)->due_tick;
+}
+
+/* Returns the tick at which the earliest delayed work is due, or
+   INT64_MAX if there is none. */
+int64_t
+workqueue_next_tick (void) {
+	return next_due_tick;
+}
+
+/* Starts WORKER_CNT threads of the given PRIORITY running WQ. */
+static void
+start_workers (struct workqueue *wq, int worker_cnt, int priority) {
+	int i;
+
+	for (i = 0; i < worker_cnt; i++) {
+		char name[16];
+
+		snprintf (name, sizeof name, "%s/%d", wq->name, i);
+		if (thread_create (name, priority, worker, wq) == TID_ERROR)
+			PANIC ("%s: cannot start worker thread", wq->name);
+	}
+}
+
+/* Worker thread.  Runs the work queued on workqueue WQ_. */
+static void
+worker (void *wq_) {
+	struct workqueue *wq = wq_;
+
+	if (wq->nice != NICE_DEFAULT)
+		thread_set_nice (wq->nice);
+
+	for (;;) {
+		enum intr_level old_level;
+		struct work *w;
+
+		old_level = intr_disable ();
+		while (list_empty (&wq->pending)) {
+			list_push_back (&wq->idle, &thread_current ()->elem);
+			thread_block ();
+		}
+		w = list_entry (list_pop_front (&wq->pending), struct work, elem);
+		w->pending = false;
+		intr_set_level (old_level);
+
+		w->func (w);
+	}
+}
+
+/* Orders delayed work by due_tick. */
+static bool
+due_tick_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct delayed_work, timer_elem)->due_tick
+		< heap_entry (b, struct delayed_work, timer_elem)->due_tick;
+}
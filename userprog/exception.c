@@ -2,6 +2,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "intrinsic.h"
@@ -11,6 +12,7 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void device_not_available (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -45,8 +47,6 @@ exception_init (void) {
 	intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
 	intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
 	intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-	intr_register_int (7, 0, INTR_ON, kill,
-			"#NM Device Not Available Exception");
 	intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
 	intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
 	intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -58,6 +58,12 @@ exception_init (void) {
 	   We need to disable interrupts for page faults because the
 	   fault address is stored in CR2 and needs to be preserved. */
 	intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+	/* #NM loads the thread's FPU state lazily (see threads/fpu.c).
+	   Interrupts stay off so that the state is loaded on the CPU
+	   that the thread returns to. */
+	intr_register_int (7, 0, INTR_OFF, device_not_available,
+			"#NM Device Not Available Exception");
 }
 
 /* Prints exception statistics. */
@@ -159,3 +165,15 @@ page_fault (struct intr_frame *f) {
 	kill (f);
 }
 
+
+/* Device-not-available handler: the running thread used the FPU
+   or SSE after a thread switch.  Hands it its FPU state.  Kernel
+   code only does so between kernel_fpu_begin() and
+   kernel_fpu_end(), which never trap. */
+static void
+device_not_available (struct intr_frame *f) {
+	if (f->cs == SEL_UCSEG && fpu_trap ())
+		return;
+	intr_enable ();
+	kill (f);
+}
@@ -10,9 +10,12 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "devices/input.h"
 #include "threads/flags.h"
+#include "threads/futex.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -22,15 +25,52 @@
 #include "vm/vm.h"
 #endif
 
+/* What a process's or thread's first thread needs to get going.
+ * Lives on the stack of the thread that creates it, which waits
+ * on DONE before returning. */
+struct start_info {
+	struct process *process;            /* Process to run in. */
+	struct process *parent;             /* Process to fork from. */
+	int slot;                           /* Slot in process's threads[]. */
+	char *file_name;                    /* Program for initd. */
+	struct intr_frame if_;              /* User context to start in. */
+	bool success;                       /* Did the fork succeed? */
+	struct semaphore done;              /* Upped once started. */
+};
+
+/* Parent of the processes that kernel threads start, such as
+ * initd.  It has no threads or address space of its own. */
+static struct process kernel_process;
+
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
-static void initd (void *f_name);
+static void initd (void *info_);
 static void __do_fork (void *);
-
-/* General process initializer for initd and other process. */
+static void start_thread (void *info_);
+static struct process *process_create (void);
+static void process_put (struct process *);
+static void process_adopt (struct process *parent, struct process *child,
+		tid_t pid);
+static hash_action_func process_put_child;
+static hash_hash_func child_hash;
+static hash_less_func child_less;
+static struct process *parent_process (void);
+static bool setup_thread_stack (struct intr_frame *if_, int slot);
+
+/* General process initializer for initd and other process.
+ * Makes the running thread a thread of P, in slot SLOT of its
+ * threads[]. */
 static void
-process_init (void) {
+process_init (struct process *p, int slot) {
 	struct thread *current = thread_current ();
+
+	lock_acquire (&p->lock);
+	p->threads[slot].tid = current->tid;
+	p->threads[slot].exited = false;
+	lock_release (&p->lock);
+
+	current->process = p;
+	current->stack_slot = slot;
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -40,37 +80,52 @@ process_init (void) {
  * Notice that THIS SHOULD BE CALLED ONCE. */
 tid_t
 process_create_initd (const char *file_name) {
-	char *fn_copy, *token, *save_ptr;
+	struct start_info info;
+	char *token, *save_ptr;
 	tid_t tid;
 
 	/* Make a copy of FILE_NAME.
 	 * Otherwise there's a race between the caller and load(). */
-	fn_copy = palloc_get_page (0);
-	if (fn_copy == NULL)
+	info.file_name = palloc_get_page (0);
+	if (info.file_name == NULL)
 		return TID_ERROR;
 
-	strlcpy (fn_copy, file_name, PGSIZE);
+	strlcpy (info.file_name, file_name, PGSIZE);
 
 	token = strtok_r(file_name, " ", &save_ptr);
 
-	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (token, PRI_DEFAULT, initd, fn_copy);
+	info.process = process_create ();
+	if (info.process == NULL) {
+		palloc_free_page (info.file_name);
+		return TID_ERROR;
+	}
+	sema_init (&info.done, 0);
 
-	if (tid == TID_ERROR)
-		palloc_free_page (fn_copy);
+	/* Create a new thread to execute FILE_NAME. */
+	tid = thread_create (token, PRI_DEFAULT, initd, &info);
+
+	if (tid == TID_ERROR) {
+		/* Drop the reference meant for the thread, and ours. */
+		palloc_free_page (info.file_name);
+		process_put (info.process);
+		process_put (info.process);
+	} else {
+		sema_down (&info.done);
+		process_adopt (parent_process (), info.process, tid);
+	}
 	return tid;
 }
 
 /* A thread function that launches first user process. */
 static void
-initd (void *f_name) {
-#ifdef VM
-	supplemental_page_table_init (&thread_current ()->spt);
-#endif
+initd (void *info_) {
+	struct start_info *info = info_;
+	char *file_name = info->file_name;
 
-	process_init ();
+	process_init (info->process, 0);
+	sema_up (&info->done);
 
-	if (process_exec (f_name) < 0)
+	if (process_exec (file_name) < 0)
 		PANIC("Fail to launch initd\n");
 	NOT_REACHED ();
 }
@@ -80,20 +135,37 @@ initd (void *f_name) {
 tid_t
 process_fork (const char *name, struct intr_frame *if_) {
 	/* Clone current thread to new thread.*/
-	struct 	thread	*parent = thread_current();
+	struct 	thread	*curr = thread_current ();
+	struct	process	*parent = curr->process;
+	struct	start_info	info;
 			tid_t	child_tid;
 
-	// memcpy(&parent->parent_if, if_, sizeof(struct intr_frame));
-
-	// printf("in process_fork: %s\n", name);
-
-	child_tid = thread_create (name, PRI_DEFAULT, __do_fork, parent);
-
-	if(child_tid == TID_ERROR)
+	info.process = process_create ();
+	if (info.process == NULL)
+		return TID_ERROR;
+	info.parent = parent;
+	info.slot = curr->stack_slot;
+	memcpy (&info.if_, if_, sizeof info.if_);
+	info.success = false;
+	sema_init (&info.done, 0);
+
+	child_tid = thread_create (name, PRI_DEFAULT, __do_fork, &info);
+
+	if (child_tid == TID_ERROR) {
+		/* Drop the reference meant for the thread, and ours. */
+		process_put (info.process);
+		process_put (info.process);
 		return TID_ERROR;
+	}
 
-	sema_down(&parent->fork_sema);
+	sema_down (&info.done);
 
+	/* A child that failed to duplicate us has exited on its own. */
+	if (!info.success) {
+		process_put (info.process);
+		return TID_ERROR;
+	}
+	process_adopt (parent, info.process, child_tid);
 	return child_tid;
 }
 
@@ -103,7 +175,7 @@ process_fork (const char *name, struct intr_frame *if_) {
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	struct thread *current = thread_current ();
-	struct thread *parent = (struct thread *) aux;
+	struct process *parent = (struct process *) aux;
 	void *parent_page;
 	void *newpage;
 	bool writable;
@@ -132,7 +204,7 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
+	if (!pml4_set_page (current->process->pml4, va, newpage, writable)) {
 		/* 6. TODO: if fail to insert page, do error handling. */
 		palloc_free_page(newpage);
 		return false;
@@ -144,73 +216,68 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 #endif
 
 /* A thread function that copies parent's execution context.
- * Hint) parent->tf does not hold the userland context of the process.
- *       That is, you are required to pass second argument of process_fork to
- *       this function. */
+ * The parent's user context arrives in the start_info, since
+ * parent->tf does not hold it. */
 static void
 __do_fork (void *aux) {
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct start_info *info = (struct start_info *) aux;
+	struct process *parent = info->parent;
+	struct process *p = info->process;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if = &parent->parent_if;
-	bool succ = true;
 
 	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
-	//memcpy (&current->tf, parent_if, sizeof(struct intr_frame));
+	memcpy (&if_, &info->if_, sizeof (struct intr_frame));
+
+	process_init (p, info->slot);
 
 	/* 2. Duplicate PT */
-	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
+	p->pml4 = pml4_create();
+	if (p->pml4 == NULL)
 		goto error;
 
 	process_activate (current);
 #ifdef VM
-	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy (&p->spt, &parent->spt))
 		goto error;
 #else
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
 		goto error;
 #endif
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
-
-	for(int i = 3; i < 64; i++)
+	/* Duplicate the file descriptors.  Holding the parent's lock
+	 * keeps its other threads from closing them meanwhile.  The
+	 * parent does not return from fork() until this is done. */
+	lock_acquire (&parent->lock);
+	for(int i = 3; i < FD_MAX; i++)
 	{
 		if(parent->file_table[i])
-			current->file_table[i] = file_duplicate(parent->file_table[i]);
+			p->file_table[i] = file_duplicate(parent->file_table[i]);
 	}
+	p->fd = parent->fd;
+	lock_release (&parent->lock);
 
-	// list_push_back(&parent->child_list, &current->child_elem);
-	// current->parent = parent;
-
-	sema_up(&parent->fork_sema);
-
-	process_init ();
+	info->success = true;
+	sema_up (&info->done);
 
 	/* Finally, switch to the newly created process. */
-	if (succ)
-	{
-		if_.R.rax = 0;
-		do_iret (&if_);
-	}
+	if_.R.rax = 0;
+	do_iret (&if_);
+	NOT_REACHED ();
+
 error:
-	// sema_up(&parent->wait_sema);
+	sema_up (&info->done);
 	thread_exit ();
 }
 
 /* Switch the current execution context to the f_name.
- * Returns -1 on fail. */
+ * Returns -1 on fail.  Fails without doing anything if the
+ * process has other threads. */
 int
 process_exec (void *f_name) {
 	char *file_name = f_name;
-	char *token, *save_ptr;
+	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
 	bool success;
 
 	/* We cannot use the intr_frame in the thread structure.
@@ -221,6 +288,18 @@ process_exec (void *f_name) {
 	_if.cs = SEL_UCSEG;
 	_if.eflags = FLAG_IF | FLAG_MBS;
 
+	/* The new program starts out with only this thread, in slot 0. */
+	lock_acquire (&p->lock);
+	if (p->thread_cnt > 1) {
+		lock_release (&p->lock);
+		palloc_free_page (file_name);
+		return -1;
+	}
+	memset (p->threads, 0, sizeof p->threads);
+	p->threads[0].tid = curr->tid;
+	curr->stack_slot = 0;
+	lock_release (&p->lock);
+
 	/* We first kill the current context */
 	process_cleanup ();
 
@@ -247,71 +326,93 @@ process_exec (void *f_name) {
  * been successfully called for the given TID, returns -1
  * immediately, without waiting.
  *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
+ * The child is taken out of the table of children before
+ * waiting, so that only one of the process's threads waits for
+ * it.  Returns -1 without waiting for the child to die if
+ * another thread of the process calls exit(). */
 int
 process_wait (tid_t child_tid) {
-	/* XXX: Hint) The pintos exit if process_wait (initd), we recommend you
-	 * XXX:       to add infinite loop here before
-	 * XXX:       implementing the process_wait. */
-	struct thread *cur_thread = thread_current();
-	struct thread *child_thread = NULL;
-	struct list_elem *e;
+	struct process *parent = parent_process ();
+	struct process *child = NULL;
+	struct process_child key;
+	struct hash_elem *e;
 	int result = -1;
 
-	for(e = list_begin(&cur_thread->child_list); e != list_end(&cur_thread->child_list); e = list_next(e))
-	{
-		struct thread *temp = list_entry(e, struct thread, child_elem);
-
-		if(temp->tid == child_tid)
-			child_thread = temp;
+	key.pid = child_tid;
+	lock_acquire (&parent->lock);
+	e = !parent->exiting ? hash_delete (&parent->children, &key.elem) : NULL;
+	if (e != NULL) {
+		child = hash_entry (e, struct process, child.elem);
+		list_push_back (&parent->waits, &child->child.wait_elem);
 	}
+	lock_release (&parent->lock);
 
-	if(child_thread == NULL)
+	if(child == NULL)
 		return -1;
 
-	// printf("child_thread: %s\n", child_thread->name);
-
-	sema_down(&child_thread->wait_sema);
-	result = child_thread->exit_status;
-	list_remove(&child_thread->child_elem);
-	// printf("@@@@@@@@@@@\n");
-	sema_up(&child_thread->exit_sema);
+	/* If another thread sets EXITING, process_terminate() ups
+	 * WAIT_SEMA to get us out of here. */
+	sema_down(&child->wait_sema);
+	lock_acquire (&parent->lock);
+	list_remove (&child->child.wait_elem);
+	if (!parent->exiting)
+		result = child->exit_status;
+	lock_release (&parent->lock);
+	process_put(child);
 
 	return result;
 }
 
-/* Exit the process. This function is called by thread_exit (). */
+/* Exit the process. This function is called by thread_exit ().
+ * Only the last thread to exit tears the process down. */
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-	/* TODO: Your code goes here.
-	 * TODO: Implement process termination message (see
-	 * TODO: project2/process_termination.html).
-	 * TODO: We recommend you to implement process resource cleanup here. */
-
-	// printf("cur: %s\n", curr->parent->name);
-	// printf("111111111\n");
-	sema_up(&curr->wait_sema);
-	// printf("222222222\n");
-	sema_down(&curr->exit_sema);
-	// printf("33333333\n");
-	process_cleanup ();
+	struct process *p = curr->process;
+	struct process_thread *slot;
+	bool last;
+
+	if (p == NULL)
+		return;
+
+	lock_acquire (&p->lock);
+	slot = &p->threads[curr->stack_slot];
+	if (slot->tid == curr->tid) {
+		slot->exited = true;
+		cond_broadcast (&p->thread_exited, &p->lock);
+	}
+	last = --p->thread_cnt == 0;
+	lock_release (&p->lock);
+
+	if (last) {
+		/* No other thread can touch the process any more. */
+		for (int i = 0; i < FD_MAX; i++)
+			if (p->file_table[i] != NULL) {
+				file_close (p->file_table[i]);
+				p->file_table[i] = NULL;
+			}
+		hash_clear (&p->children, process_put_child);
+		process_cleanup ();
+		sema_up (&p->wait_sema);
+	}
+
+	curr->process = NULL;
+	process_put (p);
 }
 
-/* Free the current process's resources. */
+/* Free the current process's address space. */
 static void
 process_cleanup (void) {
-	struct thread *curr = thread_current ();
+	struct process *p = thread_current ()->process;
 
 #ifdef VM
-	supplemental_page_table_kill (&curr->spt);
+	supplemental_page_table_kill (&p->spt);
 #endif
 
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
-	pml4 = curr->pml4;
+	pml4 = p->pml4;
 	if (pml4 != NULL) {
 		/* Correct ordering here is crucial.  We must set
 		 * cur->pagedir to NULL before switching page directories,
@@ -320,7 +421,7 @@ process_cleanup (void) {
 		 * directory before destroying the process's page
 		 * directory, or our active page directory will be one
 		 * that's been freed (and cleared). */
-		curr->pml4 = NULL;
+		p->pml4 = NULL;
 		pml4_activate (NULL);
 		pml4_destroy (pml4);
 	}
@@ -331,12 +432,258 @@ process_cleanup (void) {
 void
 process_activate (struct thread *next) {
 	/* Activate thread's page tables. */
-	pml4_activate (next->pml4);
+	pml4_activate (next->process != NULL ? next->process->pml4 : NULL);
 
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
 }
 
+/* Returns true if another thread of the running thread's process
+ * has called exit(), in which case the running thread should
+ * exit too before it returns to user mode. */
+bool
+process_exiting (void) {
+	struct process *p = thread_current ()->process;
+
+	return p != NULL && p->exiting;
+}
+
+/* Makes the running process exit with STATUS.  Its other threads
+ * exit on their way back to user mode, so this wakes those that
+ * are sleeping in the kernel: in process_wait(),
+ * process_thread_join(), futex_wait(), or reading the console. */
+void
+process_terminate (int status) {
+	struct process *p = thread_current ()->process;
+	struct list_elem *e;
+
+	if (p == NULL)
+		return;
+
+	lock_acquire (&p->lock);
+	p->exit_status = status;
+	p->exiting = true;
+	cond_broadcast (&p->thread_exited, &p->lock);
+	for (e = list_begin (&p->waits); e != list_end (&p->waits);
+			e = list_next (e))
+		sema_up (&list_entry (e, struct process, child.wait_elem)->wait_sema);
+	lock_release (&p->lock);
+
+	futex_cancel (p);
+	input_wake ();
+}
+
+/* Starts a new thread in the running process, on a user stack of
+ * its own, running user code at RIP with ARG0 and ARG1 as its
+ * first two arguments.  Returns the new thread's tid, or
+ * TID_ERROR if the process has no free thread slot or memory
+ * runs out. */
+tid_t
+process_thread_create (uint64_t rip, uint64_t arg0, uint64_t arg1) {
+	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
+	struct start_info info;
+	tid_t tid;
+	int slot;
+
+	memset (&info.if_, 0, sizeof info.if_);
+	info.if_.ds = info.if_.es = info.if_.ss = SEL_UDSEG;
+	info.if_.cs = SEL_UCSEG;
+	info.if_.eflags = FLAG_IF | FLAG_MBS;
+	info.if_.rip = rip;
+	info.if_.R.rdi = arg0;
+	info.if_.R.rsi = arg1;
+
+	/* Reserve a slot.  The page table is changed under the lock
+	 * too, so that two threads do not change it at once. */
+	lock_acquire (&p->lock);
+	for (slot = 0; slot < PROCESS_THREAD_MAX; slot++)
+		if (p->threads[slot].tid == 0)
+			break;
+	if (p->exiting || slot == PROCESS_THREAD_MAX
+			|| !setup_thread_stack (&info.if_, slot)) {
+		lock_release (&p->lock);
+		return TID_ERROR;
+	}
+	p->threads[slot].tid = TID_ERROR;
+	p->thread_cnt++;
+	__atomic_add_fetch (&p->ref_cnt, 1, __ATOMIC_RELAXED);
+	lock_release (&p->lock);
+
+	info.process = p;
+	info.slot = slot;
+	sema_init (&info.done, 0);
+
+	tid = thread_create (curr->name, curr->priority, start_thread, &info);
+	if (tid == TID_ERROR) {
+		lock_acquire (&p->lock);
+		p->threads[slot].tid = 0;
+		p->thread_cnt--;
+		lock_release (&p->lock);
+		process_put (p);
+		return TID_ERROR;
+	}
+	sema_down (&info.done);
+	return tid;
+}
+
+/* A thread function that starts a thread created by
+ * process_thread_create() in user mode. */
+static void
+start_thread (void *info_) {
+	struct start_info *info = info_;
+	struct intr_frame if_;
+
+	memcpy (&if_, &info->if_, sizeof if_);
+	process_init (info->process, info->slot);
+	process_activate (thread_current ());
+	sema_up (&info->done);
+
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Waits for thread TID of the running process to exit, and frees
+ * its slot for a new thread.  Returns 0 if successful, or -1 if
+ * TID is not a thread of the process, is the caller, or has
+ * already been joined, or if the process is exiting. */
+int
+process_thread_join (tid_t tid) {
+	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
+	struct process_thread *slot = NULL;
+	int i;
+
+	if (tid == TID_ERROR || tid == curr->tid)
+		return -1;
+
+	lock_acquire (&p->lock);
+	for (i = 0; i < PROCESS_THREAD_MAX; i++)
+		if (p->threads[i].tid == tid)
+			slot = &p->threads[i];
+	if (slot == NULL) {
+		lock_release (&p->lock);
+		return -1;
+	}
+
+	/* Another thread may join TID first and free the slot, or call
+	 * exit(), which broadcasts THREAD_EXITED too. */
+	while (slot->tid == tid && !slot->exited && !p->exiting)
+		cond_wait (&p->thread_exited, &p->lock);
+	if (slot->tid != tid || !slot->exited) {
+		lock_release (&p->lock);
+		return -1;
+	}
+	slot->tid = 0;
+	slot->exited = false;
+	lock_release (&p->lock);
+	return 0;
+}
+
+/* Creates a process with no address space and no threads, and
+ * returns it, or a null pointer if memory runs out.  It starts
+ * with two references, one for the parent and one for the first
+ * thread, which the caller must start and then pass to
+ * process_adopt(). */
+static struct process *
+process_create (void) {
+	struct process *p = calloc (1, sizeof *p);
+
+	if (p == NULL)
+		return NULL;
+
+	p->ref_cnt = 2;
+	lock_init (&p->lock);
+	p->fd = 3;
+	p->thread_cnt = 1;
+	cond_init (&p->thread_exited);
+	p->exit_status = -1;
+	sema_init (&p->wait_sema, 0);
+	list_init (&p->waits);
+	if (!hash_init (&p->children, child_hash, child_less, NULL)) {
+		free (p);
+		return NULL;
+	}
+#ifdef VM
+	supplemental_page_table_init (&p->spt);
+#endif
+	return p;
+}
+
+/* Drops a reference to P, and frees P if it was the last one. */
+static void
+process_put (struct process *p) {
+	if (__atomic_sub_fetch (&p->ref_cnt, 1, __ATOMIC_ACQ_REL) == 0) {
+		hash_destroy (&p->children, NULL);
+		free (p);
+	}
+}
+
+/* Enters CHILD, whose first thread is PID and which has started,
+ * into PARENT's children, for process_wait() to find.  CHILD may
+ * have exited already. */
+static void
+process_adopt (struct process *parent, struct process *child, tid_t pid) {
+	child->child.pid = pid;
+	lock_acquire (&parent->lock);
+	hash_insert (&parent->children, &child->child.elem);
+	lock_release (&parent->lock);
+}
+
+/* Drops a parent's reference to the child with entry E. */
+static void
+process_put_child (struct hash_elem *e, void *aux UNUSED) {
+	process_put (hash_entry (e, struct process, child.elem));
+}
+
+/* Hashes children by pid. */
+static uint64_t
+child_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct process_child, elem)->pid);
+}
+
+/* Orders children by pid. */
+static bool
+child_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct process_child, elem)->pid
+		< hash_entry (b, struct process_child, elem)->pid;
+}
+
+/* Returns the process that children started by the running
+ * thread belong to: its own, or kernel_process for a kernel
+ * thread. */
+static struct process *
+parent_process (void) {
+	static bool kernel_process_ready;
+	static bool kernel_children_ready;
+	struct process *p = thread_current ()->process;
+	enum intr_level old_level;
+
+	if (p != NULL)
+		return p;
+
+	old_level = intr_disable ();
+	if (!kernel_process_ready) {
+		lock_init (&kernel_process.lock);
+		cond_init (&kernel_process.thread_exited);
+		list_init (&kernel_process.waits);
+		kernel_process_ready = true;
+	}
+	intr_set_level (old_level);
+
+	/* hash_init() allocates, so it cannot be done above. */
+	lock_acquire (&kernel_process.lock);
+	if (!kernel_children_ready) {
+		if (!hash_init (&kernel_process.children, child_hash, child_less, NULL))
+			PANIC ("out of memory for kernel_process");
+		kernel_children_ready = true;
+	}
+	lock_release (&kernel_process.lock);
+	return &kernel_process;
+}
+
+
 /* We load ELF binaries.  The following definitions are taken
  * from the ELF specification, [ELF1], more-or-less verbatim.  */
 
@@ -418,8 +765,8 @@ load (const char *file_name, struct intr_frame *if_) {
 	char copy_fn[128];
 
 	/* Allocate and activate page directory. */
-	t->pml4 = pml4_create ();
-	if (t->pml4 == NULL)
+	t->process->pml4 = pml4_create ();
+	if (t->process->pml4 == NULL)
 		goto done;
 	
 	process_activate (thread_current ());
@@ -697,8 +1044,32 @@ install_page (void *upage, void *kpage, bool writable) {
 
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	return (pml4_get_page (t->pml4, upage) == NULL
-			&& pml4_set_page (t->pml4, upage, kpage, writable));
+	return (pml4_get_page (t->process->pml4, upage) == NULL
+			&& pml4_set_page (t->process->pml4, upage, kpage, writable));
+}
+
+/* Maps a zeroed page at the top of the user stack for thread slot
+ * SLOT, unless an earlier thread in the slot left one there, and
+ * points IF_'s stack pointer just below its top, where a null
+ * return address is stored.  Return true on success. */
+static bool
+setup_thread_stack (struct intr_frame *if_, int slot) {
+	uint8_t *upage = (uint8_t *) USER_STACK - PGSIZE
+		- (uint64_t) slot * THREAD_STACK_STRIDE;
+	uint8_t *kpage = pml4_get_page (thread_current ()->process->pml4, upage);
+
+	if (kpage == NULL) {
+		kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (kpage == NULL)
+			return false;
+		if (!install_page (upage, kpage, true)) {
+			palloc_free_page (kpage);
+			return false;
+		}
+	}
+	memset (kpage + PGSIZE - sizeof (void *), 0, sizeof (void *));
+	if_->rsp = (uint64_t) upage + PGSIZE - sizeof (void *);
+	return true;
 }
 #else
 /* From here, codes will be used after project 3.
@@ -767,4 +1138,23 @@ setup_stack (struct intr_frame *if_) {
 
 	return success;
 }
+
+/* Claims a stack page at the top of the user stack for thread
+ * slot SLOT, unless an earlier thread in the slot left one there,
+ * and points IF_'s stack pointer just below its top, where a null
+ * return address is stored.  Return true on success. */
+static bool
+setup_thread_stack (struct intr_frame *if_, int slot) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	void *stack_bottom = (uint8_t *) USER_STACK - PGSIZE
+		- (uint64_t) slot * THREAD_STACK_STRIDE;
+
+	if (spt_find_page (spt, stack_bottom) == NULL
+			&& !(vm_alloc_page (VM_ANON | VM_MARKER_0, stack_bottom, true)
+				&& vm_claim_page (stack_bottom)))
+		return false;
+	if_->rsp = (uint64_t) stack_bottom + PGSIZE - sizeof (void *);
+	*(uint64_t *) if_->rsp = 0;
+	return true;
+}
 #endif /* VM */
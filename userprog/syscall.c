@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
@@ -13,6 +14,10 @@
 #include "include/filesys/file.h"
 #include "lib/user/syscall.h"
 #include "threads/palloc.h"
+#include "threads/rcu.h"
+#include "threads/futex.h"
+#include "devices/input.h"
+#include "threads/mmu.h"
 
 
 void		syscall_entry (void);
@@ -36,6 +41,9 @@ int 		write(int, const void *, unsigned);
 void 		seek(int , unsigned);
 unsigned 	tell(int);
 void 		close(int);
+int			futex(int *, int, int);
+
+static struct file *fd_lookup (int);
 
 /* System call.
  *
@@ -49,9 +57,19 @@ void 		close(int);
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* %gs base after swapgs */
 
 void
 syscall_init (void) {
+	syscall_init_ap ();
+}
+
+/* Programs the running CPU's system call MSRs.  syscall_entry finds
+ * the CPU's struct cpu, and through it the TSS, by swapping it into
+ * %gs with swapgs. */
+void
+syscall_init_ap (void) {
+	write_msr(MSR_KERNEL_GS_BASE, (uint64_t) cpu_current ());
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -68,7 +86,10 @@ void
 syscall_handler (struct intr_frame *f) {
 	// TODO: Your implementation goes here.
 	check_syscall_handler(f);
-	// thread_exit ();
+
+	/* Another thread of the process called exit(). */
+	if(process_exiting())
+		thread_exit();
 }
 
 void
@@ -142,6 +163,21 @@ check_syscall_handler(struct intr_frame *if_)
 		case SYS_CLOSE:
 			close(if_->R.rdi);
 			break;
+		case SYS_FUTEX:
+			if_->R.rax = futex((int *) if_->R.rdi, if_->R.rsi, if_->R.rdx);
+			break;
+		case SYS_THREAD_CREATE:
+			if(is_user_vaddr(if_->R.rdi))
+				if_->R.rax = process_thread_create(if_->R.rdi, if_->R.rsi, if_->R.rdx);
+			else
+				exit(-1);
+			break;
+		case SYS_THREAD_JOIN:
+			if_->R.rax = process_thread_join(if_->R.rdi);
+			break;
+		case SYS_THREAD_EXIT:
+			thread_exit();
+			break;
 	}
 }
 
@@ -154,7 +190,7 @@ check_valid_address(uint64_t *address)
 
 	if(	address == NULL \
 		|| is_kernel_vaddr(address) \
-		|| pml4_get_page(cur_thread->pml4, address) == NULL)
+		|| pml4_get_page(cur_thread->process->pml4, address) == NULL)
 		return is_valid = false;
 
 	return is_valid;
@@ -171,8 +207,7 @@ exit(int status)
 {
 	struct	thread *cur_thread = thread_current();
 
-	cur_thread->exit_status = status;
-
+	process_terminate(status);
 	printf("%s: exit(%d)\n", cur_thread->name, status);
 
 	thread_exit();
@@ -231,32 +266,38 @@ remove(const char *file)
 int
 open(const char *file)
 {
-	struct	thread	*cur_thread = thread_current();
+	struct	process	*p = thread_current()->process;
 	struct	file	*temp_file = filesys_open(file);
+	int		fd = -1;
+
+	if(temp_file == NULL)
+		return -1;
 
-	if(temp_file)
+	lock_acquire(&p->lock);
+	if(p->fd < FD_MAX)
 	{
-		int old_fd = cur_thread->fd;
-		cur_thread->file_table[cur_thread->fd] = temp_file;
-		cur_thread->fd++;
-		return old_fd;
+		fd = p->fd++;
+		rcu_assign_pointer (p->file_table[fd], temp_file);
 	}
-	else
-		return -1;
+	lock_release(&p->lock);
+
+	if(fd < 0)
+		file_close(temp_file);
+	return fd;
 }
 
 int
 filesize(int fd)
 {
-	struct file	*target_file = thread_current()->file_table[fd];
+	struct file	*target_file = fd_lookup(fd);
+	int length;
 
-	if(fd < 0 || fd >= 64)
-	{
+	if(target_file == NULL)
 		return -1;
-	}
 
-	if(target_file)
-		return file_length(target_file);
+	length = file_length(target_file);
+	file_close(target_file);
+	return length;
 }
 
 int
@@ -269,12 +310,26 @@ read(int fd, void *buffer, unsigned size)
 	else if(fd == 1 || fd == 2)
 		return -1;
 	else if(fd == 0)
-		input_getc();
-	
-	target_file = thread_current()->file_table[fd];
+	{
+		/* Stops early if another thread calls exit(). */
+		uint8_t *dst = buffer;
+		unsigned i;
+
+		for(i = 0; i < size; i++)
+			if(!input_getc_unless(process_exiting, &dst[i]))
+				break;
+		return i;
+	}
+
+	target_file = fd_lookup(fd);
 
 	if(target_file)
-		return file_read(target_file, buffer, size);
+	{
+		int bytes_read = file_read(target_file, buffer, size);
+		file_close(target_file);
+		return bytes_read;
+	}
+	return -1;
 }
 
 int
@@ -289,10 +344,15 @@ write(int fd, const void *buffer, unsigned size)
 	else if(fd == 1)
 		putbuf(buffer, size);
 
-	target_file = thread_current()->file_table[fd];
+	target_file = fd_lookup(fd);
 
 	if(target_file)
-		return file_write(target_file, buffer, size);	
+	{
+		int bytes_written = file_write(target_file, buffer, size);
+		file_close(target_file);
+		return bytes_written;
+	}
+	return -1;
 }
 
 void
@@ -305,9 +365,12 @@ seek(int fd, unsigned position)
 		exit(-1);
 		return;
 	}
-	target_file = thread_current()->file_table[fd];
+	target_file = fd_lookup(fd);
 	if(target_file)
+	{
 		file_seek(target_file, position);
+		file_close(target_file);
+	}
 }
 
 unsigned
@@ -319,26 +382,82 @@ tell(int fd)
 	{
 		return -1;
 	}
-	target_file = thread_current()->file_table[fd];
+	target_file = fd_lookup(fd);
 	if(target_file)
-		return file_tell(target_file);
+	{
+		unsigned position = file_tell(target_file);
+		file_close(target_file);
+		return position;
+	}
+	return -1;
 }
 
 void
 close(int fd)
 {
+	struct	process *p = thread_current()->process;
 	struct	file *target_file;
 
-	if(fd < 0 || fd >= 64)
+	if(fd < 0 || fd >= FD_MAX)
 	{
 		exit(-1);
 	}
 
-	target_file = thread_current()->file_table[fd];
-	
+	lock_acquire(&p->lock);
+	target_file = p->file_table[fd];
 	if(target_file)
+		rcu_assign_pointer (p->file_table[fd], NULL);
+	lock_release(&p->lock);
+
+	/* Threads still using the file hold references of their own. */
+	file_close(target_file);
+}
+
+/* Waits on or wakes the futex at user address ADDR, which must be
+ * aligned.  FUTEX_WAIT sleeps if *ADDR equals VAL and returns 0
+ * once woken, or returns -1 right away if it does not.  FUTEX_WAKE
+ * wakes up to VAL waiters and returns how many it woke. */
+int
+futex(int *addr, int op, int val)
+{
+	int *kaddr;
+
+	if((uint64_t) addr % sizeof *addr != 0
+			|| !check_valid_address((uint64_t *) addr))
+		exit(-1);
+	kaddr = pml4_get_page(thread_current()->process->pml4, addr);
+	if(kaddr == NULL)
+		exit(-1);
+
+	switch(op)
 	{
-		file_close(target_file);
-		thread_current()->file_table[fd] = NULL;
+		case FUTEX_WAIT:
+			return futex_wait(kaddr, val, thread_current()->process,
+					process_exiting) ? 0 : -1;
+		case FUTEX_WAKE:
+			return futex_wake(kaddr, val);
+		default:
+			return -1;
 	}
-}
\ No newline at end of file
+}
+
+/* Returns the file open as FD in the current process, with a
+ * reference taken that the caller must drop with file_close(), or
+ * a null pointer if FD is not open.  The descriptor table is read
+ * under RCU, so lookups take no lock; the reference keeps the file
+ * open if another thread of the process closes FD meanwhile. */
+static struct file *
+fd_lookup (int fd)
+{
+	struct file *file;
+
+	if(fd < 0 || fd >= FD_MAX)
+		return NULL;
+
+	rcu_read_lock ();
+	file = rcu_dereference (thread_current ()->process->file_table[fd]);
+	if(file != NULL)
+		file = file_get (file);
+	rcu_read_unlock ();
+	return file;
+}
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -45,30 +46,39 @@
  *      stack pointer to point to the new thread's kernel stack.
  *      (The call is in schedule in thread.c.) */
 
-/* Kernel TSS. */
-struct task_state *tss;
+/* Each CPU has its own TSS, because each runs a different thread
+ * on a different kernel stack.  The CPU's struct cpu points to it. */
 
-/* Initializes the kernel TSS. */
+/* Initializes the boot CPU's TSS. */
 void
 tss_init (void) {
 	/* Our TSS is never used in a call gate or task gate, so only a
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
-	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	cpu_current ()->tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 	tss_update (thread_current ());
 }
 
-/* Returns the kernel TSS. */
+/* Initializes the TSS of CPU, an application processor that is
+ * about to start running its idle thread. */
+void
+tss_init_ap (struct cpu *cpu) {
+	cpu->tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	cpu->tss->rsp0 = (uint64_t) cpu->idle_thread + THREAD_STACK_SIZE;
+}
+
+/* Returns the running CPU's TSS. */
 struct task_state *
 tss_get (void) {
+	struct task_state *tss = cpu_current ()->tss;
+
 	ASSERT (tss != NULL);
 	return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
- * of the thread stack. */
+/* Sets the ring 0 stack pointer in the running CPU's TSS to point
+ * to the end of the thread stack. */
 void
 tss_update (struct thread *next) {
-	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	tss_get ()->rsp0 = (uint64_t) next + THREAD_STACK_SIZE;
 }